@@ -0,0 +1,140 @@
+#include "alloc_counter.h"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+// Constant initialized, so it is ready before any static constructor allocates.
+static std::atomic<uint64_t> g_allocation_count { 0 };
+
+// Plain constant initialized thread locals need no dynamic initialization, so operator new can use them on any thread.
+static thread_local uint64_t g_thread_allocation_count = 0;
+static thread_local uint32_t g_thread_pause_depth      = 0;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t heap_allocation_count()
+{
+    return g_allocation_count.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t thread_heap_allocation_count()
+{
+    return g_thread_allocation_count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+HeapAllocationCountPause::HeapAllocationCountPause()
+{
+    g_thread_pause_depth++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+HeapAllocationCountPause::~HeapAllocationCountPause()
+{
+    g_thread_pause_depth--;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new(size_t size)
+{
+    if (g_thread_pause_depth == 0)
+    {
+        g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+        g_thread_allocation_count++;
+    }
+
+    if (size == 0)
+        size = 1;
+
+    while (true)
+    {
+        void* ptr = malloc(size);
+
+        if (ptr)
+            return ptr;
+
+        std::new_handler handler = std::get_new_handler();
+
+        if (!handler)
+            throw std::bad_alloc();
+
+        handler();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
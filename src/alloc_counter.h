@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+// Number of times the global operator new has been called so far, on any thread. Replacing operator new is the only
+// portable hook, so memory taken with malloc directly (drivers, C libraries) is not counted, while every standard
+// container and std::function is.
+uint64_t heap_allocation_count();
+
+// Same as above for the calling thread only, so that work running on other threads meanwhile does not show up.
+uint64_t thread_heap_allocation_count();
+
+// Leaves the calling thread's allocations out of both counts while in scope, for work that a measurement should not
+// include. Scopes nest.
+class HeapAllocationCountPause
+{
+public:
+    HeapAllocationCountPause();
+    ~HeapAllocationCountPause();
+
+    HeapAllocationCountPause(const HeapAllocationCountPause&) = delete;
+    HeapAllocationCountPause& operator=(const HeapAllocationCountPause&) = delete;
+};
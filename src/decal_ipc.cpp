@@ -0,0 +1,722 @@
+#include "decal_ipc.h"
+#include <chrono>
+#include <new>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    define DECAL_IPC_SUPPORTED
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <sys/socket.h>
+#    include <sys/un.h>
+#    include <poll.h>
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <errno.h>
+#    include <signal.h>
+#endif
+
+#define DECAL_IPC_POLL_TIMEOUT_MS 1
+#define DECAL_IPC_MIN_DIRECTION_LENGTH 1e-6f
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory ring requires lock-free 64-bit atomics");
+static_assert((DECAL_IPC_RING_CAPACITY & (DECAL_IPC_RING_CAPACITY - 1)) == 0, "Ring capacity must be a power of two");
+static_assert(DECAL_IPC_MAX_BATCH_SIZE <= DECAL_IPC_RING_CAPACITY, "Batch size must fit into the ring");
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t decal_ipc_now_ns()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::string decal_ipc_shm_name()
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    return std::string(DECAL_IPC_SHM_PREFIX) + "." + std::to_string(getuid());
+#else
+    return DECAL_IPC_SHM_PREFIX;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::string decal_ipc_socket_path()
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+
+    if (runtime_dir && runtime_dir[0] != '\0')
+        return std::string(runtime_dir) + "/" + DECAL_IPC_SOCKET_NAME;
+
+    return "/tmp/tsd_decal." + std::to_string(getuid()) + ".sock";
+#else
+    return DECAL_IPC_SOCKET_NAME;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DECAL_IPC_SUPPORTED)
+// Returns the process that owns an existing ring, 0 if the segment holds no initialized ring, or -1 if it cannot be read.
+static int32_t ring_owner(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    int32_t     owner = 0;
+
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(DecalRingHeader))
+    {
+        void* ptr = mmap(nullptr, sizeof(DecalRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+
+        if (ptr != MAP_FAILED)
+        {
+            const DecalRingHeader* header = reinterpret_cast<const DecalRingHeader*>(ptr);
+
+            if (header->magic == DECAL_IPC_MAGIC && header->version == DECAL_IPC_VERSION)
+                owner = header->owner_pid;
+
+            munmap(ptr, sizeof(DecalRingHeader));
+        }
+    }
+
+    ::close(fd);
+
+    return owner;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_process_running(int32_t pid)
+{
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// A datagram socket can only be connected to while another process has it bound.
+static bool is_socket_in_use(const char* path)
+{
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+        return false;
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    bool in_use = ::connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+
+    ::close(fd);
+
+    return in_use;
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Records come from other processes, so anything that would turn into NaNs further down (the direction is normalized)
+// is rejected here.
+static bool is_valid_record(const DecalRecord& record)
+{
+    if (record.type != DECAL_RECORD_RAY && record.type != DECAL_RECORD_PROJECTOR)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (!isfinite(record.origin[i]) || !isfinite(record.direction[i]))
+            return false;
+    }
+
+    float length_sq = record.direction[0] * record.direction[0] + record.direction[1] * record.direction[1] + record.direction[2] * record.direction[2];
+
+    return isfinite(record.size) && record.size > 0.0f && isfinite(record.rotation) && length_sq >= DECAL_IPC_MIN_DIRECTION_LENGTH * DECAL_IPC_MIN_DIRECTION_LENGTH;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DecalRing::DecalRing()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DecalRing::~DecalRing()
+{
+    close();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DecalRing::create(const char* name, std::string& error)
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+
+    if (fd < 0 && errno == EEXIST)
+    {
+        int32_t owner = ring_owner(name);
+
+        if (owner < 0)
+        {
+            error = std::string("Shared ring ") + name + " exists and cannot be opened: " + strerror(errno);
+            return false;
+        }
+
+        if (is_process_running(owner))
+        {
+            error = std::string("Shared ring ") + name + " is in use by process " + std::to_string(owner);
+            return false;
+        }
+
+        // Left behind by an instance that did not shut down cleanly.
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+
+    if (fd < 0)
+    {
+        error = std::string("Failed to create shared ring ") + name + ": " + strerror(errno);
+        return false;
+    }
+
+    m_size = sizeof(DecalRingHeader) + sizeof(DecalRingCell) * DECAL_IPC_RING_CAPACITY;
+
+    if (ftruncate(fd, m_size) != 0)
+    {
+        error = std::string("Failed to size shared ring ") + name + ": " + strerror(errno);
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (ptr == MAP_FAILED)
+    {
+        error = std::string("Failed to map shared ring ") + name + ": " + strerror(errno);
+        shm_unlink(name);
+        return false;
+    }
+
+    m_header = new (ptr) DecalRingHeader();
+    m_cells  = reinterpret_cast<DecalRingCell*>(m_header + 1);
+    m_owner  = true;
+    m_name   = name;
+
+    m_header->capacity  = DECAL_IPC_RING_CAPACITY;
+    m_header->owner_pid = int32_t(getpid());
+    m_header->enqueue_pos.store(0);
+    m_header->dequeue_pos.store(0);
+    m_header->submitted.store(0);
+    m_header->producer_drops.store(0);
+    m_header->applied.store(0);
+    m_header->latency_sum_ns.store(0);
+    m_header->latency_max_ns.store(0);
+
+    for (uint32_t i = 0; i < DECAL_IPC_RING_CAPACITY; i++)
+        new (&m_cells[i].sequence) std::atomic<uint64_t>(i);
+
+    m_header->version = DECAL_IPC_VERSION;
+
+    // Publish the magic last so that producers never observe a partially initialized ring.
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = DECAL_IPC_MAGIC;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DecalRing::open(const char* name)
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    int fd = shm_open(name, O_RDWR, 0600);
+
+    if (fd < 0)
+        return false;
+
+    m_size = sizeof(DecalRingHeader) + sizeof(DecalRingCell) * DECAL_IPC_RING_CAPACITY;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < m_size)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (ptr == MAP_FAILED)
+        return false;
+
+    DecalRingHeader* header = reinterpret_cast<DecalRingHeader*>(ptr);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (header->magic != DECAL_IPC_MAGIC || header->version != DECAL_IPC_VERSION || header->capacity != DECAL_IPC_RING_CAPACITY)
+    {
+        munmap(ptr, m_size);
+        return false;
+    }
+
+    m_header = header;
+    m_cells  = reinterpret_cast<DecalRingCell*>(m_header + 1);
+    m_owner  = false;
+    m_name   = name;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DecalRing::close()
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    if (!m_header)
+        return;
+
+    munmap(m_header, m_size);
+
+    if (m_owner)
+        shm_unlink(m_name.c_str());
+
+    m_header = nullptr;
+    m_cells  = nullptr;
+    m_owner  = false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DecalRing::push_batch(const DecalRecord* records, uint32_t count)
+{
+    if (!m_header || count == 0 || count > DECAL_IPC_MAX_BATCH_SIZE)
+        return false;
+
+    const uint64_t mask = DECAL_IPC_RING_CAPACITY - 1;
+    uint64_t       pos  = m_header->enqueue_pos.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        // The consumer releases cells strictly in order, so if the first and last cell of the batch are free for this
+        // lap then so is every cell in between.
+        uint64_t first = m_cells[pos & mask].sequence.load(std::memory_order_acquire);
+        uint64_t last  = m_cells[(pos + count - 1) & mask].sequence.load(std::memory_order_acquire);
+
+        if (int64_t(first - pos) < 0 || int64_t(last - (pos + count - 1)) < 0)
+        {
+            // Ring is full.
+            m_header->producer_drops.fetch_add(count, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (first == pos && last == pos + count - 1)
+        {
+            if (m_header->enqueue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                break;
+        }
+        else
+        {
+            // Another producer claimed part of the range first.
+            pos = m_header->enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        DecalRingCell& cell = m_cells[(pos + i) & mask];
+
+        cell.record = records[i];
+        cell.sequence.store(pos + i + 1, std::memory_order_release);
+    }
+
+    m_header->submitted.fetch_add(count, std::memory_order_relaxed);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t DecalRing::pop_batch(DecalRecord* records, uint32_t max_count)
+{
+    if (!m_header)
+        return 0;
+
+    const uint64_t mask  = DECAL_IPC_RING_CAPACITY - 1;
+    uint64_t       pos   = m_header->dequeue_pos.load(std::memory_order_relaxed);
+    uint32_t       count = 0;
+
+    while (count < max_count)
+    {
+        DecalRingCell& cell = m_cells[pos & mask];
+
+        // Stop at the first cell that has not been published yet.
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+            break;
+
+        records[count++] = cell.record;
+        cell.sequence.store(pos + DECAL_IPC_RING_CAPACITY, std::memory_order_release);
+        pos++;
+    }
+
+    m_header->dequeue_pos.store(pos, std::memory_order_relaxed);
+
+    return count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DecalSubmissionService::DecalSubmissionService() :
+    m_running(false), m_received_ring(0), m_received_socket(0), m_rejected(0)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DecalSubmissionService::~DecalSubmissionService()
+{
+    stop();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DecalSubmissionService::start(const char* shm_name, const char* socket_path, uint32_t queue_capacity)
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    if (m_running)
+        return true;
+
+    m_queue.resize(queue_capacity);
+    m_queue_head  = 0;
+    m_queue_count = 0;
+    m_error.clear();
+
+    bool ring_ok = m_ring.create(shm_name, m_error);
+
+    // Datagram socket fallback for producers that cannot map the shared ring (e.g. running in a container). Like the
+    // ring, a socket file is only replaced if no running process has it bound.
+    if (is_socket_in_use(socket_path))
+        m_error += std::string(m_error.empty() ? "" : ", ") + "socket " + socket_path + " is in use by another process";
+    else
+        m_socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    if (m_socket >= 0)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+        unlink(socket_path);
+
+        // Bind with a restrictive umask so that the socket is never accessible by other users, not even briefly.
+        mode_t mask   = umask(0177);
+        bool   bound  = bind(m_socket, (sockaddr*)&addr, sizeof(addr)) == 0;
+        int    reason = errno;
+
+        umask(mask);
+
+        if (!bound)
+        {
+            m_error += std::string(m_error.empty() ? "" : ", ") + "failed to bind socket " + socket_path + ": " + strerror(reason);
+
+            ::close(m_socket);
+            m_socket = -1;
+        }
+        else
+            m_socket_path = socket_path;
+    }
+
+    if (!ring_ok && m_socket < 0)
+        return false;
+
+    m_running = true;
+    m_thread  = std::thread(&DecalSubmissionService::reader_thread, this);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DecalSubmissionService::stop()
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    if (!m_running)
+        return;
+
+    m_running = false;
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_socket >= 0)
+    {
+        ::close(m_socket);
+        unlink(m_socket_path.c_str());
+        m_socket = -1;
+    }
+
+    m_ring.close();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t DecalSubmissionService::dequeue(DecalRecord* records, uint32_t max_count)
+{
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+
+    uint32_t count    = m_queue_count < max_count ? m_queue_count : max_count;
+    uint32_t capacity = uint32_t(m_queue.size());
+
+    for (uint32_t i = 0; i < count; i++)
+        records[i] = m_queue[(m_queue_head + i) % capacity];
+
+    m_queue_head = (m_queue_head + count) % capacity;
+    m_queue_count -= count;
+
+    return count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DecalSubmissionService::record_applied(const DecalRecord& record)
+{
+    DecalRingHeader* header = m_ring.header();
+
+    if (!header)
+        return;
+
+    uint64_t latency = decal_ipc_now_ns() - record.submit_time_ns;
+    uint64_t max     = header->latency_max_ns.load(std::memory_order_relaxed);
+
+    while (latency > max && !header->latency_max_ns.compare_exchange_weak(max, latency, std::memory_order_relaxed))
+        ;
+
+    header->latency_sum_ns.fetch_add(latency, std::memory_order_relaxed);
+    header->applied.fetch_add(1, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DecalSubmissionService::stats(DecalSubmissionStats& stats)
+{
+    DecalRingHeader* header = m_ring.header();
+
+    stats.received_ring   = m_received_ring.load();
+    stats.received_socket = m_received_socket.load();
+    stats.rejected        = m_rejected.load();
+    stats.producer_drops  = header ? header->producer_drops.load() : 0;
+    stats.applied         = header ? header->applied.load() : 0;
+    stats.avg_latency_ms  = stats.applied > 0 ? double(header->latency_sum_ns.load()) / (double(stats.applied) * 1000000.0) : 0.0;
+    stats.max_latency_ms  = header ? double(header->latency_max_ns.load()) / 1000000.0 : 0.0;
+
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    stats.queued = m_queue_count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t DecalSubmissionService::free_queue_space()
+{
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    return uint32_t(m_queue.size()) - m_queue_count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DecalSubmissionService::enqueue(const DecalRecord* records, uint32_t count, std::atomic<uint64_t>& counter)
+{
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+
+    uint32_t capacity = uint32_t(m_queue.size());
+    uint32_t accepted = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!is_valid_record(records[i]))
+        {
+            m_rejected++;
+            continue;
+        }
+
+        m_queue[(m_queue_head + m_queue_count) % capacity] = records[i];
+        m_queue_count++;
+        accepted++;
+    }
+
+    counter += accepted;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DecalSubmissionService::reader_thread()
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    DecalRecord batch[DECAL_IPC_MAX_BATCH_SIZE];
+
+    while (m_running)
+    {
+        // Only consume as much as the render queue can take. Anything else stays in the ring or the socket buffer so
+        // that producers see backpressure instead of silently losing decals here.
+        uint32_t space    = free_queue_space();
+        bool     consumed = false;
+
+        if (space > 0 && m_ring.is_open())
+        {
+            uint32_t count = m_ring.pop_batch(batch, space < DECAL_IPC_MAX_BATCH_SIZE ? space : DECAL_IPC_MAX_BATCH_SIZE);
+
+            if (count > 0)
+            {
+                enqueue(batch, count, m_received_ring);
+                space -= count;
+                consumed = true;
+            }
+        }
+
+        // A datagram holds up to a full batch, so only read one if it is guaranteed to fit.
+        if (space >= DECAL_IPC_MAX_BATCH_SIZE && m_socket >= 0)
+        {
+            pollfd pfd;
+            pfd.fd      = m_socket;
+            pfd.events  = POLLIN;
+            pfd.revents = 0;
+
+            if (poll(&pfd, 1, consumed ? 0 : DECAL_IPC_POLL_TIMEOUT_MS) > 0 && (pfd.revents & POLLIN))
+            {
+                ssize_t size = recv(m_socket, batch, sizeof(batch), 0);
+
+                if (size > 0)
+                {
+                    if (size % sizeof(DecalRecord) != 0)
+                        m_rejected++;
+                    else
+                        enqueue(batch, uint32_t(size / sizeof(DecalRecord)), m_received_socket);
+                }
+            }
+        }
+        else if (!consumed)
+            std::this_thread::sleep_for(std::chrono::milliseconds(DECAL_IPC_POLL_TIMEOUT_MS));
+    }
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DecalSubmissionClient::DecalSubmissionClient()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DecalSubmissionClient::~DecalSubmissionClient()
+{
+    disconnect();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DecalSubmissionClient::connect(const char* shm_name, const char* socket_path, bool force_socket)
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    // The ring is mapped even in socket mode so that the shared statistics can be read.
+    bool ring_ok = m_ring.open(shm_name);
+
+    m_use_socket = force_socket || !ring_ok;
+
+    if (!m_use_socket)
+        return true;
+
+    m_socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    if (m_socket < 0)
+        return false;
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    if (::connect(m_socket, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        ::close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DecalSubmissionClient::disconnect()
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    if (m_socket >= 0)
+    {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+
+    m_ring.close();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DecalSubmissionClient::submit(const DecalRecord* records, uint32_t count)
+{
+#if defined(DECAL_IPC_SUPPORTED)
+    if (!m_use_socket)
+        return m_ring.push_batch(records, count);
+
+    if (m_socket < 0 || count == 0 || count > DECAL_IPC_MAX_BATCH_SIZE)
+        return false;
+
+    // Never block the simulation: a full socket buffer means the consumer is applying backpressure.
+    ssize_t size = send(m_socket, records, sizeof(DecalRecord) * count, MSG_DONTWAIT);
+
+    if (size < 0)
+    {
+        if (m_ring.header())
+            m_ring.header()->producer_drops.fetch_add(count, std::memory_order_relaxed);
+
+        return false;
+    }
+
+    if (m_ring.header())
+        m_ring.header()->submitted.fetch_add(count, std::memory_order_relaxed);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <string>
+
+#define DECAL_IPC_SHM_PREFIX "/tsd_decal_ring"
+#define DECAL_IPC_SOCKET_NAME "tsd_decal.sock"
+#define DECAL_IPC_RING_CAPACITY 8192
+#define DECAL_IPC_MAX_BATCH_SIZE 64
+#define DECAL_IPC_MAGIC 0x4C414344 // 'DCAL'
+#define DECAL_IPC_VERSION 2
+
+enum DecalRecordType : uint32_t
+{
+    // Ray cast against the scene, the decal is placed at the closest hit.
+    DECAL_RECORD_RAY = 0,
+    // Explicit projector position and direction, no ray cast required.
+    DECAL_RECORD_PROJECTOR = 1
+};
+
+struct DecalRecord
+{
+    uint32_t type;
+    int32_t  decal_index;
+    float    origin[3];
+    float    direction[3];
+    float    size;
+    float    rotation;
+    uint64_t submit_time_ns;
+};
+
+// Single cell of the shared ring. The sequence number implements a bounded lock-free queue (D. Vyukov) that allows any
+// number of producer processes and a single consumer.
+struct DecalRingCell
+{
+    std::atomic<uint64_t> sequence;
+    DecalRecord           record;
+};
+
+struct DecalRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    int32_t  owner_pid;
+    alignas(64) std::atomic<uint64_t> enqueue_pos;
+    alignas(64) std::atomic<uint64_t> dequeue_pos;
+
+    // Statistics, written by both sides so that producers can observe the end-to-end behaviour.
+    alignas(64) std::atomic<uint64_t> submitted;
+    std::atomic<uint64_t> producer_drops;
+    std::atomic<uint64_t> applied;
+    std::atomic<uint64_t> latency_sum_ns;
+    std::atomic<uint64_t> latency_max_ns;
+};
+
+struct DecalSubmissionStats
+{
+    uint64_t received_ring;
+    uint64_t received_socket;
+    uint64_t rejected;
+    uint64_t producer_drops;
+    uint64_t applied;
+    uint64_t queued;
+    double   avg_latency_ms;
+    double   max_latency_ms;
+};
+
+// Monotonic timestamp shared by all processes on the machine.
+uint64_t decal_ipc_now_ns();
+
+// Both endpoints are per user and only accessible by that user. The ring is named after the user id, and the socket
+// lives in $XDG_RUNTIME_DIR, or in /tmp named after the user id if that is not set.
+std::string decal_ipc_shm_name();
+std::string decal_ipc_socket_path();
+
+class DecalRing
+{
+public:
+    DecalRing();
+    ~DecalRing();
+
+    // Creates (consumer) or opens (producer) the named shared memory segment. A segment left behind by a process that
+    // has exited is replaced, but one that a running process owns is not, and creating then fails with an error.
+    bool create(const char* name, std::string& error);
+    bool open(const char* name);
+    void close();
+
+    // Pushes the whole batch or nothing. Returns false if the ring does not have room for it.
+    bool push_batch(const DecalRecord* records, uint32_t count);
+
+    // Pops up to max_count published records. Must only be called from a single consumer thread.
+    uint32_t pop_batch(DecalRecord* records, uint32_t max_count);
+
+    inline DecalRingHeader* header() { return m_header; }
+    inline bool             is_open() { return m_header != nullptr; }
+
+private:
+    DecalRingHeader* m_header = nullptr;
+    DecalRingCell*   m_cells  = nullptr;
+    size_t           m_size   = 0;
+    bool             m_owner  = false;
+    std::string      m_name;
+};
+
+// Consumer side: owns the shared ring and the socket, and feeds a bounded queue drained by the render thread.
+class DecalSubmissionService
+{
+public:
+    DecalSubmissionService();
+    ~DecalSubmissionService();
+
+    bool start(const char* shm_name, const char* socket_path, uint32_t queue_capacity);
+    void stop();
+
+    // Called from the render thread.
+    uint32_t dequeue(DecalRecord* records, uint32_t max_count);
+    void     record_applied(const DecalRecord& record);
+    void     stats(DecalSubmissionStats& stats);
+
+    inline bool               is_running() { return m_running; }
+    inline const std::string& error() const { return m_error; }
+
+private:
+    void     reader_thread();
+    uint32_t free_queue_space();
+    void     enqueue(const DecalRecord* records, uint32_t count, std::atomic<uint64_t>& counter);
+
+private:
+    DecalRing                m_ring;
+    int                      m_socket = -1;
+    std::string              m_socket_path;
+    std::string              m_error;
+    std::thread              m_thread;
+    std::atomic<bool>        m_running;
+    std::mutex               m_queue_mutex;
+    std::vector<DecalRecord> m_queue;
+    uint32_t                 m_queue_head  = 0;
+    uint32_t                 m_queue_count = 0;
+    std::atomic<uint64_t>    m_received_ring;
+    std::atomic<uint64_t>    m_received_socket;
+    std::atomic<uint64_t>    m_rejected;
+};
+
+// Producer side: submits batches through the shared ring, or through the socket if the ring is unavailable.
+class DecalSubmissionClient
+{
+public:
+    DecalSubmissionClient();
+    ~DecalSubmissionClient();
+
+    bool connect(const char* shm_name, const char* socket_path, bool force_socket = false);
+    void disconnect();
+
+    // Returns false if the batch was dropped because the consumer is applying backpressure.
+    bool submit(const DecalRecord* records, uint32_t count);
+
+    // Shared statistics, only available when the ring could be mapped.
+    inline DecalRingHeader* shared_header() { return m_ring.header(); }
+    inline bool             using_socket() { return m_use_socket; }
+
+private:
+    DecalRing m_ring;
+    int       m_socket     = -1;
+    bool      m_use_socket = false;
+};
@@ -0,0 +1,222 @@
+// Stand-alone load generator for the decal submission service. Submits batches of random decal rays aimed at the
+// scene at a fixed rate and reports the sustained submission/application rate and the end-to-end latency as observed
+// through the shared statistics of the ring.
+
+#include "decal_ipc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <random>
+#include <chrono>
+#include <thread>
+
+#define DEFAULT_RATE 10000
+#define DEFAULT_BATCH_SIZE 16
+#define DEFAULT_DURATION 10
+#define SPAWN_RADIUS 150.0f
+#define TARGET_RADIUS 30.0f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void print_usage()
+{
+    printf("usage: DecalLoadGen [--rate decals_per_second] [--batch size] [--seconds duration] [--socket]\n");
+    printf("  --rate     Target submission rate, 0 submits as fast as possible (default: %d)\n", DEFAULT_RATE);
+    printf("  --batch    Records per batch, at most %d (default: %d)\n", DECAL_IPC_MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE);
+    printf("  --seconds  Duration of the run (default: %d)\n", DEFAULT_DURATION);
+    printf("  --socket   Force the Unix domain socket fallback instead of the shared ring\n");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The whole argument has to be a decimal count. atoi would silently turn garbage into 0 (as fast as possible for --rate)
+// and negative values into huge ones.
+static bool parse_uint(const char* str, uint32_t& value)
+{
+    if (*str < '0' || *str > '9')
+        return false;
+
+    char* end = nullptr;
+
+    errno = 0;
+    unsigned long parsed = strtoul(str, &end, 10);
+
+    if (*end != '\0' || errno != 0 || parsed > UINT32_MAX)
+        return false;
+
+    value = uint32_t(parsed);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void fill_record(DecalRecord& record, std::mt19937& gen)
+{
+    std::uniform_real_distribution<float> unit_dis(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale_dis(5.0f, 20.0f);
+    std::uniform_real_distribution<float> rotation_dis(-90.0f, 90.0f);
+    std::uniform_int_distribution<>       index_dis(0, 3);
+
+    // Spawn on a sphere around the scene and aim at a random point near its center.
+    float origin[3] = { unit_dis(gen), unit_dis(gen) * 0.5f, unit_dis(gen) };
+    float length    = sqrtf(origin[0] * origin[0] + origin[1] * origin[1] + origin[2] * origin[2]) + 1e-6f;
+    float target[3] = { unit_dis(gen) * TARGET_RADIUS, unit_dis(gen) * TARGET_RADIUS, unit_dis(gen) * TARGET_RADIUS };
+    float dir[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        origin[i] = origin[i] / length * SPAWN_RADIUS;
+        dir[i]    = target[i] - origin[i];
+    }
+
+    float dir_length = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+    record.type        = DECAL_RECORD_RAY;
+    record.decal_index = index_dis(gen);
+    record.size        = scale_dis(gen);
+    record.rotation    = rotation_dis(gen);
+
+    for (int i = 0; i < 3; i++)
+    {
+        record.origin[i]    = origin[i];
+        record.direction[i] = dir[i] / dir_length;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+    uint32_t rate         = DEFAULT_RATE;
+    uint32_t batch_size   = DEFAULT_BATCH_SIZE;
+    uint32_t duration     = DEFAULT_DURATION;
+    bool     force_socket = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool valid = true;
+
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            valid = parse_uint(argv[++i], rate);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            valid = parse_uint(argv[++i], batch_size);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            valid = parse_uint(argv[++i], duration);
+        else if (strcmp(argv[i], "--socket") == 0)
+            force_socket = true;
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (batch_size == 0 || batch_size > DECAL_IPC_MAX_BATCH_SIZE)
+    {
+        printf("Batch size must be between 1 and %d\n", DECAL_IPC_MAX_BATCH_SIZE);
+        return 1;
+    }
+
+    DecalSubmissionClient client;
+
+    if (!client.connect(decal_ipc_shm_name().c_str(), decal_ipc_socket_path().c_str(), force_socket))
+    {
+        printf("Failed to connect to the decal submission service, is TextureSpaceDecals running?\n");
+        return 1;
+    }
+
+    printf("Connected via %s, rate = %u decals/s, batch = %u, duration = %u s\n", client.using_socket() ? "socket" : "shared ring", rate, batch_size, duration);
+
+    DecalRingHeader* header = client.shared_header();
+
+    uint64_t applied_start = header ? header->applied.load() : 0;
+    uint64_t latency_start = header ? header->latency_sum_ns.load() : 0;
+
+    std::mt19937 gen(std::random_device {}());
+    DecalRecord  batch[DECAL_IPC_MAX_BATCH_SIZE];
+    uint64_t     submitted = 0;
+    uint64_t     dropped   = 0;
+
+    const uint64_t start_ns        = decal_ipc_now_ns();
+    const uint64_t end_ns          = start_ns + uint64_t(duration) * 1000000000ull;
+    const double   batch_period_ns = rate > 0 ? 1e9 * double(batch_size) / double(rate) : 0.0;
+    uint64_t       next_report_ns  = start_ns + 1000000000ull;
+    uint64_t       batch_index     = 0;
+
+    while (true)
+    {
+        uint64_t now = decal_ipc_now_ns();
+
+        if (now >= end_ns)
+            break;
+
+        // Pace batches against the absolute schedule so that a slow iteration does not reduce the sustained rate.
+        if (rate > 0)
+        {
+            uint64_t due = start_ns + uint64_t(batch_period_ns * double(batch_index));
+
+            if (now < due)
+            {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+                continue;
+            }
+        }
+
+        for (uint32_t i = 0; i < batch_size; i++)
+            fill_record(batch[i], gen);
+
+        uint64_t submit_time = decal_ipc_now_ns();
+
+        for (uint32_t i = 0; i < batch_size; i++)
+            batch[i].submit_time_ns = submit_time;
+
+        if (client.submit(batch, batch_size))
+            submitted += batch_size;
+        else
+            dropped += batch_size;
+
+        batch_index++;
+
+        if (submit_time >= next_report_ns)
+        {
+            double elapsed = double(submit_time - start_ns) / 1e9;
+            printf("[%5.1f s] submitted %10llu (%9.0f/s), dropped %8llu", elapsed, (unsigned long long)submitted, double(submitted) / elapsed, (unsigned long long)dropped);
+
+            if (header)
+                printf(", applied %10llu", (unsigned long long)(header->applied.load() - applied_start));
+
+            printf("\n");
+            next_report_ns += 1000000000ull;
+        }
+    }
+
+    double elapsed = double(decal_ipc_now_ns() - start_ns) / 1e9;
+
+    // Give the renderer a moment to drain whatever is still queued before reading the final statistics.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    printf("\n");
+    printf("Submitted      : %llu (%.0f decals/s)\n", (unsigned long long)submitted, double(submitted) / elapsed);
+    printf("Dropped        : %llu\n", (unsigned long long)dropped);
+
+    if (header)
+    {
+        uint64_t applied = header->applied.load() - applied_start;
+        uint64_t latency = header->latency_sum_ns.load() - latency_start;
+
+        printf("Applied        : %llu (%.0f decals/s)\n", (unsigned long long)applied, double(applied) / elapsed);
+        printf("Avg latency    : %.3f ms\n", applied > 0 ? double(latency) / (double(applied) * 1e6) : 0.0);
+        printf("Max latency    : %.3f ms (since service start)\n", double(header->latency_max_ns.load()) / 1e6);
+    }
+    else
+        printf("Shared statistics unavailable, application rate and latency not reported.\n");
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
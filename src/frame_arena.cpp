@@ -0,0 +1,96 @@
+#include "frame_arena.h"
+#include <algorithm>
+
+#define FRAME_ARENA_SPILL_BLOCKS 16
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FrameArena::FrameArena(size_t capacity) :
+    m_capacity(std::max(capacity, size_t(FRAME_ARENA_ALIGNMENT)))
+{
+    m_data = new uint8_t[m_capacity];
+    m_spill_blocks.reserve(FRAME_ARENA_SPILL_BLOCKS);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FrameArena::~FrameArena()
+{
+    for (uint8_t* block : m_spill_blocks)
+        delete[] block;
+
+    delete[] m_data;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* FrameArena::allocate(size_t size)
+{
+    size = (size + FRAME_ARENA_ALIGNMENT - 1) & ~size_t(FRAME_ARENA_ALIGNMENT - 1);
+
+    void* ptr;
+
+    if (m_offset + size <= m_capacity)
+    {
+        ptr = m_data + m_offset;
+        m_offset += size;
+    }
+    else
+    {
+        // Does not fit this frame. The spill lives until the next reset, which then makes room for it up front.
+        uint8_t* block = new uint8_t[size];
+
+        m_spill_blocks.push_back(block);
+        m_spilled += size;
+
+        ptr = block;
+    }
+
+    m_peak = std::max(m_peak, m_offset + m_spilled);
+
+    return ptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void FrameArena::reserve(size_t capacity)
+{
+    if (capacity <= m_capacity)
+        return;
+
+    delete[] m_data;
+
+    m_data     = new uint8_t[capacity];
+    m_capacity = capacity;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void FrameArena::reset()
+{
+    for (uint8_t* block : m_spill_blocks)
+        delete[] block;
+
+    m_spill_blocks.clear();
+
+    if (m_peak > m_capacity)
+    {
+        size_t capacity = m_capacity;
+
+        while (capacity < m_peak)
+            capacity *= 2;
+
+        delete[] m_data;
+
+        m_data     = new uint8_t[capacity];
+        m_capacity = capacity;
+        m_grow_count++;
+    }
+
+    m_last_peak = m_peak;
+    m_offset    = 0;
+    m_spilled   = 0;
+    m_peak      = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define FRAME_ARENA_ALIGNMENT 16
+
+// Linear allocator for data that does not outlive the frame. Allocating bumps an offset into one block and nothing is
+// freed individually: reset() drops everything at the start of a frame and release() rewinds to an earlier marker. A
+// frame that does not fit spills into separate blocks, and the next reset() grows the main block so that it fits.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size);
+    void  reset();
+
+    // Grows the main block to at least capacity up front, for callers that know how much a frame needs. Only valid while
+    // nothing is allocated.
+    void reserve(size_t capacity);
+
+    template <typename T>
+    inline T* allocate_array(size_t count) { return static_cast<T*>(allocate(count * sizeof(T))); }
+
+    // Rewinds to the marker, so that a loop can reuse the same memory for each of its iterations. Spilled blocks are
+    // only freed by reset().
+    inline size_t marker() const { return m_offset; }
+    inline void   release(size_t marker) { m_offset = marker < m_offset ? marker : m_offset; }
+
+    // Peak is the most the previous frame had allocated at once, spills included.
+    inline size_t capacity() const { return m_capacity; }
+    inline size_t peak() const { return m_last_peak; }
+    inline size_t grow_count() const { return m_grow_count; }
+
+private:
+    uint8_t*              m_data       = nullptr;
+    size_t                m_capacity   = 0;
+    size_t                m_offset     = 0;
+    size_t                m_spilled    = 0;
+    size_t                m_peak       = 0;
+    size_t                m_last_peak  = 0;
+    size_t                m_grow_count = 0;
+    std::vector<uint8_t*> m_spill_blocks;
+};
+
+// Releases everything allocated from the arena while it is in scope.
+class FrameArenaScope
+{
+public:
+    explicit FrameArenaScope(FrameArena& arena) :
+        m_arena(arena), m_marker(arena.marker())
+    {
+    }
+
+    ~FrameArenaScope()
+    {
+        m_arena.release(m_marker);
+    }
+
+private:
+    FrameArena& m_arena;
+    size_t      m_marker;
+};
+
+// Array with a fixed capacity carved out of a frame arena. Storage is only valid until the arena is released past it.
+template <typename T>
+class ArenaArray
+{
+public:
+    ArenaArray(FrameArena& arena, size_t capacity) :
+        m_data(arena.allocate_array<T>(capacity)), m_capacity(capacity)
+    {
+    }
+
+    inline void push_back(const T& value) { m_data[m_size++] = value; }
+
+    inline T*       begin() { return m_data; }
+    inline T*       end() { return m_data + m_size; }
+    inline T&       operator[](size_t i) { return m_data[i]; }
+    inline size_t   size() const { return m_size; }
+    inline size_t   capacity() const { return m_capacity; }
+    inline bool     empty() const { return m_size == 0; }
+    inline const T* data() const { return m_data; }
+
+private:
+    T*     m_data;
+    size_t m_size = 0;
+    size_t m_capacity;
+};
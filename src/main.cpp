@@ -9,17 +9,63 @@
 #include <random>
 #include <chrono>
 #include <random>
+#include <algorithm>
+#include <fstream>
+#include <cerrno>
+#include <cmath>
 #include <rtccore.h>
 #include <rtcore_geometry.h>
 #include <rtcore_common.h>
 #include <rtcore_ray.h>
 #include <rtcore_device.h>
 #include <rtcore_scene.h>
+#include "vertex_cache.h"
+#include "decal_ipc.h"
+#include "undo_history.h"
+#include "task_scheduler.h"
+#include "mesh_chunks.h"
+#include "frame_arena.h"
+#include "alloc_counter.h"
 
 #define CAMERA_FAR_PLANE 1000.0f
-#define PROJECTOR_BACK_OFF_DISTANCE 10.0f;
-#define ALBEDO_TEXTURE_SIZE 4096
+#define CAMERA_FOV 60.0f
+#define PROJECTOR_BACK_OFF_DISTANCE 10.0f
+#define MIN_ATLAS_SIZE 512
+#define MAX_ATLAS_SIZE 4096
+#define DEFAULT_TARGET_TEXEL_DENSITY 16.0f
 #define DEPTH_TEXTURE_SIZE 512
+#define DECAL_CHANNEL_COUNT 3
+#define DECAL_NORMAL_STRENGTH 4.0f
+#define DECAL_DEFAULT_ROUGHNESS 0.25f
+#define VERTEX_STREAM_BENCHMARK_ITERATIONS 100
+#define SUBMISSION_QUEUE_CAPACITY 4096
+#define MAX_SUBMITTED_DECALS_PER_FRAME 256
+#define GLOBAL_UBO_SLICES (2 * MAX_SUBMITTED_DECALS_PER_FRAME)
+#define DECAL_LOD_MIN_TEXELS 16.0f
+#define DISTANT_IMPACT_COUNT 64
+#define DISTANT_IMPACT_DISTANCE 600.0f
+#define LOD_DECAL_CAPACITY 4096
+#define LOD_REFINEMENTS_PER_FRAME 4
+#define HISTORY_TILE_SIZE 64
+#define HISTORY_TILE_LEVELS 7
+#define HISTORY_TILES_PER_READBACK 256
+#define HISTORY_UNDO_ARENA_SIZE (32 * 1024 * 1024)
+#define HISTORY_REDO_ARENA_SIZE (16 * 1024 * 1024)
+#define TASK_GRAIN_SIZE 4096
+#define PICK_GRAIN_SIZE 16
+#define DECAL_LAYER_GRAIN_ROWS 16
+#define HEADLESS_DEFAULT_DECALS 256
+#define HEADLESS_MAX_ATTEMPTS 16
+#define HEADLESS_SEED 1337
+#define IDLE_FRAME_THRESHOLD 2
+#define IDLE_WAIT_TIMEOUT 0.1
+#define DEFAULT_MESH_PATH "mesh/teapot_smooth.obj"
+#define CHUNK_DEFAULT_MEMORY_MB 512
+#define CHUNK_MAX_MEMORY_MB 8192
+#define CHUNK_LOADS_IN_FLIGHT 4
+#define CHUNK_BVH_BYTES_PER_TRIANGLE 64
+#define FRAME_ARENA_SIZE (1024 * 1024)
+#define DECAL_ALLOCATION_WARM_UP 16
 
 struct GlobalUniforms
 {
@@ -31,6 +77,207 @@ struct GlobalUniforms
     glm::vec4 cam_pos;
 };
 
+// Tightly packed vertex used by the passes that only need position, UV and normal (depth, texture init and decal
+// projection). The normal is only read by the decal projection, to orient decal normals on the surface.
+struct SlimVertex
+{
+    glm::vec3 position;
+    uint16_t  tex_coord[2];
+    uint32_t  normal;
+};
+
+enum DecalChannel
+{
+    DECAL_CHANNEL_ALBEDO    = 0,
+    DECAL_CHANNEL_NORMAL    = 1,
+    DECAL_CHANNEL_ROUGHNESS = 2
+};
+
+// Describes one UV-space render target of the decal atlas and the matching layer of the decal assets.
+struct DecalChannelDesc
+{
+    const char* name;
+    const char* file_suffix;
+    const char* decal_sampler;
+    const char* atlas_sampler;
+    GLenum      internal_format;
+    GLenum      format;
+    uint32_t    pixel_size;
+    GLenum      blend_src;
+    GLenum      blend_dst;
+    float       clear_color[4];
+};
+
+static const DecalChannelDesc DECAL_CHANNELS[DECAL_CHANNEL_COUNT] = {
+    { "Albedo", "", "s_Decal", "s_Albedo", GL_RGB8, GL_RGB, 3, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, { 0.0f, 0.0f, 0.0f, 1.0f } },
+    { "Normal", "_normal", "s_DecalNormal", "s_Normal", GL_RGB8, GL_RGB, 3, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, { 128.0f / 255.0f, 128.0f / 255.0f, 1.0f, 1.0f } },
+    { "Roughness", "_roughness", "s_DecalRoughness", "s_Roughness", GL_R8, GL_RED, 1, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, { 1.0f, 0.0f, 0.0f, 1.0f } }
+};
+
+static const GLenum DECAL_CHANNEL_ATTACHMENTS[DECAL_CHANNEL_COUNT] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+
+struct DecalAsset
+{
+    std::unique_ptr<dw::Texture2D> layers[DECAL_CHANNEL_COUNT];
+};
+
+// Inverse of a matrix that only changes now and then, like the camera's. Comparing against the last input is much
+// cheaper than inverting it again.
+struct CachedInverse
+{
+    glm::mat4 matrix  = glm::mat4(1.0f);
+    glm::mat4 inverse = glm::mat4(1.0f);
+
+    const glm::mat4& get(const glm::mat4& m)
+    {
+        if (m != matrix)
+        {
+            matrix  = m;
+            inverse = glm::inverse(m);
+        }
+
+        return inverse;
+    }
+};
+
+struct ProjectorState
+{
+    glm::vec3 hit_pos;
+    glm::vec3 hit_normal;
+    float     hit_distance;
+    glm::vec3 projector_pos;
+    glm::vec3 projector_dir;
+    float     projector_size;
+    float     projector_rotation;
+    int32_t   selected_decal;
+};
+
+// Command line options. These are parsed before the application starts, as some of them affect window creation.
+struct LaunchOptions
+{
+    float       texel_density    = DEFAULT_TARGET_TEXEL_DENSITY;
+    uint32_t    thread_count     = 0;
+    bool        pin_threads      = false;
+    bool        headless         = false;
+    uint32_t    frames           = 0;
+    uint32_t    decals           = HEADLESS_DEFAULT_DECALS;
+    uint32_t    decals_per_frame = 1;
+    std::string dump_prefix;
+    std::string report_path;
+    std::string mesh_path      = DEFAULT_MESH_PATH;
+    uint32_t    mesh_memory_mb = CHUNK_DEFAULT_MEMORY_MB;
+};
+
+static LaunchOptions g_launch_options;
+
+// Everything that the presented image depends on. If none of it changed, the last frame can be shown again.
+struct FrameState
+{
+    glm::mat4 view_proj;
+    glm::mat4 light_view_proj;
+    glm::vec4 cam_pos;
+    glm::vec3 hit_pos;
+    bool      has_hit;
+    int32_t   width;
+    int32_t   height;
+    uint64_t  atlas_version;
+    uint64_t  geometry_version;
+    bool      visualize_albedo_map;
+    int32_t   visualized_channel;
+    bool      visualize_hit_point;
+    bool      visualize_projection_frustum;
+
+    bool operator==(const FrameState& other) const
+    {
+        return view_proj == other.view_proj && light_view_proj == other.light_view_proj && cam_pos == other.cam_pos && hit_pos == other.hit_pos && has_hit == other.has_hit && width == other.width && height == other.height && atlas_version == other.atlas_version && geometry_version == other.geometry_version && visualize_albedo_map == other.visualize_albedo_map && visualized_channel == other.visualized_channel && visualize_hit_point == other.visualize_hit_point && visualize_projection_frustum == other.visualize_projection_frustum;
+    }
+};
+
+enum ChunkState
+{
+    CHUNK_UNLOADED = 0,
+    CHUNK_LOADING  = 1,
+    CHUNK_RESIDENT = 2
+};
+
+// One chunk of a streamed mesh. While it is loading, its data and BVH belong to the scheduler task that reads them.
+struct StreamedChunk
+{
+    ChunkState                        state  = CHUNK_UNLOADED;
+    bool                              failed = false;
+    TaskGroup                         load;
+    MeshChunkData                     data;
+    RTCScene                          scene = nullptr;
+    std::unique_ptr<dw::VertexBuffer> vbo;
+    std::unique_ptr<dw::IndexBuffer>  ibo;
+    std::unique_ptr<dw::VertexArray>  vao;
+};
+
+struct UvBounds
+{
+    glm::vec2 uv_min = glm::vec2(1.0f);
+    glm::vec2 uv_max = glm::vec2(0.0f);
+    bool      found  = false;
+};
+
+// Attribute access shared by the in-memory mesh and the streamed chunks.
+static inline glm::vec3 vertex_position(const dw::Vertex& vertex) { return vertex.position; }
+static inline glm::vec3 vertex_position(const ChunkVertex& vertex) { return glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]); }
+static inline glm::vec2 vertex_tex_coord(const dw::Vertex& vertex) { return vertex.tex_coord; }
+static inline glm::vec2 vertex_tex_coord(const ChunkVertex& vertex) { return glm::vec2(vertex.tex_coord[0], vertex.tex_coord[1]); }
+
+// Packs a unit vector as GL_INT_2_10_10_10_REV, read back as a normalized vec3.
+static inline uint32_t pack_snorm_10_10_10(const glm::vec3& v)
+{
+    glm::ivec3 q = glm::ivec3(glm::round(glm::clamp(v, glm::vec3(-1.0f), glm::vec3(1.0f)) * 511.0f));
+
+    return (uint32_t(q.x) & 0x3FF) | ((uint32_t(q.y) & 0x3FF) << 10) | ((uint32_t(q.z) & 0x3FF) << 20);
+}
+
+struct RayHit
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    float     distance;
+};
+
+// Before-image tiles of one decal batch on their way back from the GPU. Each pixel pack buffer holds up to
+// HISTORY_TILES_PER_READBACK tiles, with the channels of a tile stored one after the other.
+struct HistoryReadback
+{
+    std::vector<GLuint>   pbos;
+    std::vector<uint32_t> tiles;
+    GLsync                fence           = nullptr;
+    uint32_t              batch           = 0;
+    bool                  refinement_only = false;
+};
+
+// Undo steps only hold tiles, this says which batch each of them came from.
+struct HistoryBatch
+{
+    uint32_t serial;
+    bool     refinement_only;
+};
+
+enum LodDecalStatus
+{
+    LOD_DECAL_STALE,
+    LOD_DECAL_REFINED,
+    LOD_DECAL_UNDONE
+};
+
+// Decal that was only written to a coarse level of the atlas, kept so that it can be written to mip 0 once that level
+// is about to be rebuilt from finer ones, or once the viewer comes close enough to see what it is missing.
+struct LodDecal
+{
+    ProjectorState state;
+    glm::vec4      uv_rect;
+    int32_t        lod;
+    LodDecalStatus status;
+    uint32_t       created_batch;
+    uint32_t       refined_batch; // 0 until refined, batch serials start at 1.
+};
+
 class TextureSpaceDecals : public dw::Application
 {
 protected:
@@ -38,6 +285,24 @@ protected:
 
     bool init(int argc, const char* argv[]) override
     {
+        m_target_texel_density = g_launch_options.texel_density;
+        m_thread_count         = g_launch_options.thread_count;
+        m_pin_threads          = g_launch_options.pin_threads;
+        m_headless             = g_launch_options.headless;
+        m_chunk_memory_mb      = int32_t(g_launch_options.mesh_memory_mb);
+
+        // Every CPU side job (BVH builds, picking, decal bounds and asset processing) runs on this one set of threads.
+        m_scheduler.start(m_thread_count, m_pin_threads);
+
+        // Seeded once, a random device per pick is costly and may allocate.
+        m_decal_rng.seed(std::random_device()());
+
+        // Uniforms are looked up by std::string, and names past the small string buffer would allocate on every draw.
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            m_decal_sampler_names[i] = DECAL_CHANNELS[i].decal_sampler;
+
+        m_lod_decals.reserve(LOD_DECAL_CAPACITY);
+
         // Create GPU resources.
         if (!create_shaders())
             return false;
@@ -49,12 +314,33 @@ protected:
         if (!load_scene())
             return false;
 
+        // Projecting the vertices of the mesh (or of its largest chunk) is by far the largest scratch allocation of a
+        // decal. Making room for it up front keeps even the first decals off the heap, the rest fits in FRAME_ARENA_SIZE.
+        m_frame_arena.reserve(FRAME_ARENA_SIZE + size_t(largest_vertex_count()) * sizeof(glm::vec3));
+
+        if (m_mesh && !create_slim_vertex_stream())
+            return false;
+
         if (!load_decals())
             return false;
 
         if (!initialize_embree())
             return false;
 
+        // Accept decals from external processes. Not being able to start the service is not fatal. Headless runs only
+        // apply their own decals so that they stay reproducible.
+        if (!m_headless)
+        {
+            if (!m_submission_service.start(decal_ipc_shm_name().c_str(), decal_ipc_socket_path().c_str(), SUBMISSION_QUEUE_CAPACITY))
+                DW_LOG_WARNING("Failed to start decal submission service: " + m_submission_service.error());
+            else if (!m_submission_service.error().empty())
+                DW_LOG_WARNING("Decal submission service only partially started: " + m_submission_service.error());
+        }
+
+        m_submitted_decals.resize(MAX_SUBMITTED_DECALS_PER_FRAME);
+        m_submitted_hits.resize(MAX_SUBMITTED_DECALS_PER_FRAME);
+        m_submitted_retrace.resize(MAX_SUBMITTED_DECALS_PER_FRAME);
+
         create_framebuffers();
 
         // Create camera.
@@ -62,8 +348,12 @@ protected:
 
         m_transform = glm::mat4(1.0f);
 
+        init_history();
         init_texture();
 
+        if (m_headless)
+            begin_headless_run();
+
         return true;
     }
 
@@ -71,49 +361,109 @@ protected:
 
     void update(double delta) override
     {
+        if (m_headless)
+            m_frame_start = std::chrono::high_resolution_clock::now();
+
+        // Nothing allocated from the arena last frame is still in use.
+        m_frame_arena.reset();
+
+        // A wait in the previous frame is part of this frame's delta.
+        m_woke_from_idle = m_idle_waited;
+        m_idle_waited    = false;
+
+        // Nothing changed for a while, so sleep until there is input. The timeout picks up externally submitted decals.
+        // Waiting before the camera and UI update lets the input that ends the wait show up in this frame.
+        if (m_render_on_demand && m_idle_mode && m_unchanged_frames >= IDLE_FRAME_THRESHOLD && m_pending_readbacks.empty() && m_chunk_loads_in_flight == 0)
+        {
+            glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+
+            m_idle_waited = true;
+            m_idle_waits++;
+        }
+
         // Update camera.
         update_camera();
 
         update_global_uniforms(m_global_uniforms);
 
+        // Without worker threads nothing would read the chunks in the background. Headless runs wait for them as well,
+        // so that every run sees the same geometry.
+        if (is_streaming_mesh())
+            update_chunk_streaming(m_headless || m_scheduler.thread_count() <= 1);
+
         if (m_debug_gui)
             ui();
 
+        // Move finished before-image readbacks into the undo history.
+        resolve_history_readbacks(false);
+
         if (m_requires_update)
         {
             m_requires_update = false;
-            render_depth_map();
-            apply_decals();
-            m_albedo_texture->generate_mipmaps();
+            apply_decal(m_main_camera->m_position);
         }
 
-        render_lit_scene();
+        apply_submitted_decals();
 
-        if (m_visualize_albedo_map)
-            visualize_albedo_map();
+        if (m_headless)
+            apply_headless_decals();
 
-        if (m_hit_distance != INFINITY)
+        // Everything applied this frame is undone as one step.
+        end_history_batch();
+
+        // Refinements on approach get steps of their own, which undo and redo step over along with the edit they follow.
+        refine_approached_lod_decals();
+        end_history_batch();
+
+        FrameState state = current_frame_state();
+
+        if (m_render_on_demand && m_frame_state_valid && state == m_last_frame_state)
+            m_unchanged_frames++;
+        else
         {
-            if (m_visualize_hit_point)
-                m_debug_draw.sphere(2.0f, m_hit_pos, glm::vec3(1.0f, 0.0f, 0.0f));
+            m_unchanged_frames = 0;
 
-            if (m_visualize_projection_frustum)
-                m_debug_draw.frustum(m_global_uniforms.light_view_proj, glm::vec3(0.0f, 1.0f, 0.0f));
+            render_frame(m_render_on_demand ? m_scene_fbo.get() : nullptr);
 
-            if (m_visualize_hit_point || m_visualize_projection_frustum)
-                m_debug_draw.render(nullptr, m_width, m_height, m_global_uniforms.view_proj);
+            m_last_frame_state  = state;
+            m_frame_state_valid = true;
+            m_frames_rendered++;
         }
+
+        // The UI is drawn on top of the default framebuffer after this, so the cached frame is copied there every time.
+        if (m_render_on_demand)
+            present_cached_frame();
+
+        m_frames_presented++;
+
+        if (m_headless)
+            end_headless_frame();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     void shutdown() override
     {
-        rtcReleaseGeometry(m_embree_triangle_mesh);
+        m_submission_service.stop();
+
+        reset_history();
+        glDeleteBuffers(GLsizei(m_free_pbos.size()), m_free_pbos.data());
+
+        glDeleteFramebuffers(1, &m_lod_read_fbo);
+        glDeleteFramebuffers(1, &m_lod_draw_fbo);
+
+        if (is_streaming_mesh())
+            close_streamed_mesh();
+        else
+        {
+            rtcReleaseGeometry(m_embree_triangle_mesh);
+            dw::Mesh::unload(m_mesh);
+        }
+
         rtcReleaseScene(m_embree_scene);
         rtcReleaseDevice(m_embree_device);
 
-        dw::Mesh::unload(m_mesh);
+        m_scheduler.stop();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -121,9 +471,12 @@ protected:
     void window_resized(int width, int height) override
     {
         // Override window resized method to update camera projection.
-        m_main_camera->update_projection(60.0f, 0.1f, CAMERA_FAR_PLANE, float(m_width) / float(m_height));
+        m_main_camera->update_projection(CAMERA_FOV, 0.1f, CAMERA_FAR_PLANE, float(m_width) / float(m_height));
 
         create_framebuffers();
+
+        // The atlas was recreated, so the recorded tiles no longer apply to it.
+        reset_history();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -147,6 +500,14 @@ protected:
 
         if (code == GLFW_KEY_G)
             m_debug_gui = !m_debug_gui;
+
+        if (glfwGetKey(m_window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(m_window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS)
+        {
+            if (code == GLFW_KEY_Z)
+                undo();
+            else if (code == GLFW_KEY_Y)
+                redo();
+        }
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -175,56 +536,26 @@ protected:
             glfwGetCursorPos(m_window, &xpos, &ypos);
 
             glm::vec4 ndc_pos      = glm::vec4((2.0f * float(xpos)) / float(m_width) - 1.0f, 1.0 - (2.0f * float(ypos)) / float(m_height), -1.0f, 1.0f);
-            glm::vec4 view_coords  = glm::inverse(m_main_camera->m_projection) * ndc_pos;
-            glm::vec4 world_coords = glm::inverse(m_main_camera->m_view) * glm::vec4(view_coords.x, view_coords.y, -1.0f, 0.0f);
+            glm::vec4 view_coords  = m_inv_projection.get(m_main_camera->m_projection) * ndc_pos;
+            glm::vec4 world_coords = m_inv_view.get(m_main_camera->m_view) * glm::vec4(view_coords.x, view_coords.y, -1.0f, 0.0f);
 
             glm::vec3 ray_dir = glm::normalize(glm::vec3(world_coords));
 
-            RTCRayHit rayhit;
-
-            rayhit.ray.dir_x = ray_dir.x;
-            rayhit.ray.dir_y = ray_dir.y;
-            rayhit.ray.dir_z = ray_dir.z;
-
-            rayhit.ray.org_x = m_main_camera->m_position.x;
-            rayhit.ray.org_y = m_main_camera->m_position.y;
-            rayhit.ray.org_z = m_main_camera->m_position.z;
-
-            rayhit.ray.tnear     = 0;
-            rayhit.ray.tfar      = INFINITY;
-            rayhit.ray.mask      = 0;
-            rayhit.ray.flags     = 0;
-            rayhit.hit.geomID    = RTC_INVALID_GEOMETRY_ID;
-            rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
-
-            rtcIntersect1(m_embree_scene, &m_embree_intersect_context, &rayhit);
-
-            if (rayhit.ray.tfar != INFINITY)
+            if (place_decal(m_main_camera->m_position, ray_dir))
             {
-                m_hit_pos      = m_main_camera->m_position + ray_dir * rayhit.ray.tfar;
-                m_hit_normal   = glm::vec3(rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z);
-                m_hit_distance = rayhit.ray.tfar;
-
-                m_projector_pos = m_hit_pos + m_hit_normal * PROJECTOR_BACK_OFF_DISTANCE;
-                m_projector_dir = -m_hit_normal;
-
                 m_requires_update = true;
 
                 if (m_randomize_decals)
                 {
-                    std::random_device                    rd;
-                    std::mt19937                          gen(rd());
                     std::uniform_real_distribution<float> scale_dis(5.0, 20.0);
                     std::uniform_real_distribution<float> rotation_dis(-90.0, 90.0);
                     std::uniform_int_distribution<>       index_dis(0, 3);
 
-                    m_selected_decal     = index_dis(gen);
-                    m_projector_size     = scale_dis(gen);
-                    m_projector_rotation = rotation_dis(gen);
+                    m_selected_decal     = index_dis(m_decal_rng);
+                    m_projector_size     = scale_dis(m_decal_rng);
+                    m_projector_rotation = rotation_dis(m_decal_rng);
                 }
             }
-            else
-                rayhit.ray.tfar = INFINITY;
         }
 
         // Enable mouse look.
@@ -266,269 +597,2630 @@ protected:
 private:
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void init_texture()
+    bool intersect_ray(const glm::vec3& origin, const glm::vec3& dir, RayHit& hit)
     {
-        if (m_enable_conservative_raster)
-        {
-            if (GLAD_GL_NV_conservative_raster)
-                glEnable(GL_CONSERVATIVE_RASTERIZATION_NV);
-            else if (GLAD_GL_INTEL_conservative_rasterization)
-                glEnable(GL_INTEL_conservative_rasterization);
-        }
-
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
-
-        glDisable(GL_CULL_FACE);
+        // Called from any scheduler thread, so the context is local.
+        RTCIntersectContext context;
+        RTCRayHit           rayhit;
 
-        m_albedo_fbo->bind();
+        rtcInitIntersectContext(&context);
 
-        glViewport(0, 0, ALBEDO_TEXTURE_SIZE, ALBEDO_TEXTURE_SIZE);
+        rayhit.ray.dir_x = dir.x;
+        rayhit.ray.dir_y = dir.y;
+        rayhit.ray.dir_z = dir.z;
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // Bind shader program.
-        m_texture_init_program->use();
-
-        // Bind uniform buffers.
-        m_global_ubo->bind_base(0);
-
-        m_texture_init_program->set_uniform("u_Model", m_transform);
+        rayhit.ray.org_x = origin.x;
+        rayhit.ray.org_y = origin.y;
+        rayhit.ray.org_z = origin.z;
 
-        // Bind vertex array.
-        m_mesh->mesh_vertex_array()->bind();
+        rayhit.ray.tnear     = 0;
+        rayhit.ray.tfar      = INFINITY;
+        rayhit.ray.mask      = 0;
+        rayhit.ray.flags     = 0;
+        rayhit.hit.geomID    = RTC_INVALID_GEOMETRY_ID;
+        rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
-        dw::SubMesh* submeshes = m_mesh->sub_meshes();
+        rtcIntersect1(m_embree_scene, &context, &rayhit);
 
-        for (uint32_t i = 0; i < m_mesh->sub_mesh_count(); i++)
-        {
-            dw::SubMesh& submesh = submeshes[i];
+        hit.distance = rayhit.ray.tfar;
 
-            // Issue draw call.
-            glDrawElementsBaseVertex(GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
-        }
+        if (rayhit.ray.tfar == INFINITY)
+            return false;
 
-        if (m_enable_conservative_raster)
-        {
-            if (GLAD_GL_NV_conservative_raster)
-                glDisable(GL_CONSERVATIVE_RASTERIZATION_NV);
-            else if (GLAD_GL_INTEL_conservative_rasterization)
-                glDisable(GL_INTEL_conservative_rasterization);
-        }
+        hit.position = origin + dir * rayhit.ray.tfar;
+        hit.normal   = glm::vec3(rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z);
 
-        m_albedo_texture->generate_mipmaps();
+        return true;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void apply_decals()
+    void place_decal(const RayHit& hit)
     {
-        if (m_enable_conservative_raster)
-        {
-            if (GLAD_GL_NV_conservative_raster)
-                glEnable(GL_CONSERVATIVE_RASTERIZATION_NV);
-            else if (GLAD_GL_INTEL_conservative_rasterization)
-                glEnable(GL_INTEL_conservative_rasterization);
-        }
+        m_hit_pos      = hit.position;
+        m_hit_normal   = hit.normal;
+        m_hit_distance = hit.distance;
 
-        glDisable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        m_projector_pos = m_hit_pos + m_hit_normal * PROJECTOR_BACK_OFF_DISTANCE;
+        m_projector_dir = -m_hit_normal;
+    }
 
-        glDisable(GL_CULL_FACE);
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-        m_albedo_fbo->bind();
+    // Casts a ray against the whole mesh. A streamed mesh only traces its resident chunks, so the chunks that the ray
+    // enters before its hit are loaded and the ray is cast again until none is left.
+    bool intersect_mesh(const glm::vec3& origin, const glm::vec3& dir, RayHit& hit)
+    {
+        bool found = intersect_ray(origin, dir, hit);
 
-        glViewport(0, 0, ALBEDO_TEXTURE_SIZE, ALBEDO_TEXTURE_SIZE);
+        while (is_streaming_mesh())
+        {
+            bool missing = mark_nearer_chunks(origin, dir, hit.distance);
 
-        // Bind shader program.
-        m_decal_program->use();
+            load_required_chunks();
 
-        // Bind uniform buffers.
-        m_global_ubo->bind_base(0);
+            if (!missing)
+                break;
 
-        m_decal_program->set_uniform("u_Model", m_transform);
+            found = intersect_ray(origin, dir, hit);
+        }
 
-        // Bind vertex array.
-        m_mesh->mesh_vertex_array()->bind();
+        return found;
+    }
 
-        dw::SubMesh* submeshes = m_mesh->sub_meshes();
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-        for (uint32_t i = 0; i < m_mesh->sub_mesh_count(); i++)
-        {
-            dw::SubMesh& submesh = submeshes[i];
+    bool place_decal(const glm::vec3& origin, const glm::vec3& dir)
+    {
+        RayHit hit;
 
-            if (m_decal_program->set_uniform("s_Decal", 0))
-                m_decal_textures[m_selected_decal]->bind(0);
+        if (!intersect_mesh(origin, dir, hit))
+            return false;
 
-            if (m_decal_program->set_uniform("s_Depth", 1))
-                m_depth_texture->bind(1);
+        place_decal(hit);
 
-            // Issue draw call.
-            glDrawElementsBaseVertex(GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
-        }
+        return true;
+    }
 
-        glDisable(GL_BLEND);
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-        if (m_enable_conservative_raster)
-        {
-            if (GLAD_GL_NV_conservative_raster)
-                glDisable(GL_CONSERVATIVE_RASTERIZATION_NV);
-            else if (GLAD_GL_INTEL_conservative_rasterization)
-                glDisable(GL_INTEL_conservative_rasterization);
-        }
+    ProjectorState save_projector_state()
+    {
+        ProjectorState state;
+
+        state.hit_pos            = m_hit_pos;
+        state.hit_normal         = m_hit_normal;
+        state.hit_distance       = m_hit_distance;
+        state.projector_pos      = m_projector_pos;
+        state.projector_dir      = m_projector_dir;
+        state.projector_size     = m_projector_size;
+        state.projector_rotation = m_projector_rotation;
+        state.selected_decal     = m_selected_decal;
+
+        return state;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_depth_map()
+    void restore_projector_state(const ProjectorState& state)
     {
-        render_scene(m_depth_fbo.get(), m_depth_program, 0, 0, DEPTH_TEXTURE_SIZE, DEPTH_TEXTURE_SIZE, GL_BACK);
+        m_hit_pos            = state.hit_pos;
+        m_hit_normal         = state.hit_normal;
+        m_hit_distance       = state.hit_distance;
+        m_projector_pos      = state.projector_pos;
+        m_projector_dir      = state.projector_dir;
+        m_projector_size     = state.projector_size;
+        m_projector_rotation = state.projector_rotation;
+        m_selected_decal     = state.selected_decal;
+
+        update_transforms(m_main_camera.get());
+        update_global_uniforms(m_global_uniforms);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_lit_scene()
+    static glm::vec3 record_origin(const DecalRecord& record)
     {
-        render_scene(nullptr, m_mesh_program, 0, 0, m_width, m_height, GL_BACK);
+        return glm::vec3(record.origin[0], record.origin[1], record.origin[2]);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void visualize_albedo_map()
+    static glm::vec3 record_direction(const DecalRecord& record)
     {
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-        glDisable(GL_BLEND);
-
-        glViewport(0, 0, 512, 512);
+        return glm::normalize(glm::vec3(record.direction[0], record.direction[1], record.direction[2]));
+    }
 
-        // Bind shader program.
-        m_visualize_program->use();
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-        if (m_visualize_program->set_uniform("s_Texture", 0))
-            m_albedo_texture->bind(0);
+    void cast_submitted_rays(uint32_t count, bool retrace_only)
+    {
+        m_scheduler.parallel_for(count, PICK_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                const DecalRecord& record = m_submitted_decals[i];
 
-        // Render fullscreen triangle
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+                if (record.type == DECAL_RECORD_RAY && (!retrace_only || m_submitted_retrace[i]))
+                    intersect_ray(record_origin(record), record_direction(record), m_submitted_hits[i]);
+            }
+        });
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    bool create_shaders()
+    void apply_submitted_decals()
     {
+        uint32_t count = m_submission_service.dequeue(m_submitted_decals.data(), MAX_SUBMITTED_DECALS_PER_FRAME);
+
+        if (count == 0)
+            return;
+
+        // Cast the rays of the whole batch up front, in parallel.
+        cast_submitted_rays(count, false);
+
+        // Like intersect_mesh(), but loading the chunks for the whole batch at once and only casting the affected rays again.
+        while (is_streaming_mesh())
         {
-            // Create general shaders
-            m_uv_space_vs      = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/uv_space_vs.glsl"));
-            m_texture_init_fs  = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/texture_init_fs.glsl"));
-            m_decal_project_fs = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/decal_project_fs.glsl"));
-            m_mesh_vs          = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/mesh_vs.glsl"));
-            m_mesh_fs          = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/mesh_fs.glsl"));
-            m_triangle_vs      = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/fullscreen_triangle_vs.glsl"));
-            m_visualize_fs     = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/visualize_albedo_fs.glsl"));
-            m_depth_vs         = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/depth_vs.glsl"));
-            m_depth_fs         = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_fs.glsl"));
+            bool missing = false;
 
+            for (uint32_t i = 0; i < count; i++)
             {
-                if (!m_uv_space_vs || !m_decal_project_fs)
-                {
-                    DW_LOG_FATAL("Failed to create Shaders");
-                    return false;
-                }
+                const DecalRecord& record = m_submitted_decals[i];
 
-                // Create general shader program
-                dw::Shader* shaders[] = { m_uv_space_vs.get(), m_decal_project_fs.get() };
-                m_decal_program       = std::make_unique<dw::Program>(2, shaders);
+                m_submitted_retrace[i] = record.type == DECAL_RECORD_RAY && mark_nearer_chunks(record_origin(record), record_direction(record), m_submitted_hits[i].distance);
+                missing                = missing || m_submitted_retrace[i];
+            }
 
-                if (!m_decal_program)
-                {
-                    DW_LOG_FATAL("Failed to create Shader Program");
-                    return false;
-                }
+            load_required_chunks();
 
-                m_decal_program->uniform_block_binding("GlobalUniforms", 0);
-            }
+            if (!missing)
+                break;
 
-            {
-                if (!m_uv_space_vs || !m_texture_init_fs)
-                {
-                    DW_LOG_FATAL("Failed to create Shaders");
-                    return false;
+            cast_submitted_rays(count, true);
+        }
+
+        // Submitted decals reuse the projector state, so keep the interactive one around and restore it afterwards.
+        ProjectorState state = save_projector_state();
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const DecalRecord& record = m_submitted_decals[i];
+
+            glm::vec3 origin = record_origin(record);
+            glm::vec3 dir    = record_direction(record);
+
+            if (record.type == DECAL_RECORD_RAY)
+            {
+                if (m_submitted_hits[i].distance == INFINITY)
+                    continue;
+
+                place_decal(m_submitted_hits[i]);
+            }
+            else
+            {
+                m_projector_pos = origin;
+                m_projector_dir = dir;
+                m_hit_pos       = origin + dir * PROJECTOR_BACK_OFF_DISTANCE;
+                m_hit_normal    = -dir;
+                m_hit_distance  = PROJECTOR_BACK_OFF_DISTANCE;
+            }
+
+            m_selected_decal     = glm::clamp(record.decal_index, 0, int32_t(m_decal_assets.size()) - 1);
+            m_projector_size     = record.size;
+            m_projector_rotation = record.rotation;
+
+            update_transforms(m_main_camera.get());
+            update_global_uniforms(m_global_uniforms);
+
+            apply_decal(m_main_camera->m_position);
+
+            m_submission_service.record_applied(record);
+        }
+
+        restore_projector_state(state);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void init_texture()
+    {
+        if (m_enable_conservative_raster)
+        {
+            if (GLAD_GL_NV_conservative_raster)
+                glEnable(GL_CONSERVATIVE_RASTERIZATION_NV);
+            else if (GLAD_GL_INTEL_conservative_rasterization)
+                glEnable(GL_INTEL_conservative_rasterization);
+        }
+
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+
+        glDisable(GL_CULL_FACE);
+
+        m_atlas_fbo->bind();
+
+        glViewport(0, 0, m_atlas_size, m_atlas_size);
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            glClearBufferfv(GL_COLOR, i, DECAL_CHANNELS[i].clear_color);
+
+        // Bind shader program.
+        m_texture_init_program->use();
+
+        // Bind uniform buffers.
+        bind_global_uniforms();
+
+        m_texture_init_program->set_uniform("u_Model", m_transform);
+
+        // Every chunk of a streamed mesh is initialized, rather than only the resident ones.
+        if (is_streaming_mesh())
+            draw_all_chunks();
+        else
+            draw_mesh(m_mesh->mesh_vertex_array(), m_global_uniforms.view_proj);
+
+        if (m_enable_conservative_raster)
+        {
+            if (GLAD_GL_NV_conservative_raster)
+                glDisable(GL_CONSERVATIVE_RASTERIZATION_NV);
+            else if (GLAD_GL_INTEL_conservative_rasterization)
+                glDisable(GL_INTEL_conservative_rasterization);
+        }
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            m_atlas_textures[i]->generate_mipmaps();
+
+        // Clearing is not undoable, and older steps would restore tiles on top of the cleared atlas.
+        reset_history();
+
+        m_atlas_version++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void set_decal_blend_state()
+    {
+        // Each render target gets its own blend state.
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+        {
+            glEnablei(GL_BLEND, i);
+            glBlendFunci(i, DECAL_CHANNELS[i].blend_src, DECAL_CHANNELS[i].blend_dst);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_decal(uint32_t size, bool blend)
+    {
+        if (m_enable_conservative_raster)
+        {
+            if (GLAD_GL_NV_conservative_raster)
+                glEnable(GL_CONSERVATIVE_RASTERIZATION_NV);
+            else if (GLAD_GL_INTEL_conservative_rasterization)
+                glEnable(GL_INTEL_conservative_rasterization);
+        }
+
+        glDisable(GL_DEPTH_TEST);
+
+        if (blend)
+            set_decal_blend_state();
+        else
+            glDisable(GL_BLEND);
+
+        glDisable(GL_CULL_FACE);
+
+        glViewport(0, 0, size, size);
+
+        // Bind shader program.
+        m_decal_program->use();
+
+        // Bind uniform buffers.
+        bind_global_uniforms();
+
+        m_decal_program->set_uniform("u_Model", m_transform);
+
+        // Decal normals are in projector space, the normal atlas is in object space.
+        m_decal_program->set_uniform("u_DecalToObject", m_inv_transform.get(m_transform) * m_inv_projector_view.get(m_projector_view));
+
+        // All channels are written by a single draw through multiple render targets.
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+        {
+            if (m_decal_program->set_uniform(m_decal_sampler_names[i], i))
+                m_decal_assets[m_selected_decal].layers[i]->bind(i);
+        }
+
+        if (m_decal_program->set_uniform("s_Depth", DECAL_CHANNEL_COUNT))
+            m_depth_texture->bind(DECAL_CHANNEL_COUNT);
+
+        draw_mesh(uv_pass_vertex_array(), m_global_uniforms.light_view_proj);
+
+        glDisable(GL_BLEND);
+
+        if (m_enable_conservative_raster)
+        {
+            if (GLAD_GL_NV_conservative_raster)
+                glDisable(GL_CONSERVATIVE_RASTERIZATION_NV);
+            else if (GLAD_GL_INTEL_conservative_rasterization)
+                glDisable(GL_INTEL_conservative_rasterization);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void apply_decal(const glm::vec3& viewer_pos)
+    {
+        // Only counts the calling thread, and chunk loads pause counting wherever they run. Tasks the decal hands to
+        // the workers are not counted, parallel_for itself never allocates.
+        uint64_t allocations = thread_heap_allocation_count();
+
+        apply_decal_with_arena(viewer_pos);
+
+        m_last_decal_allocations = thread_heap_allocation_count() - allocations;
+
+        if (++m_decals_measured > DECAL_ALLOCATION_WARM_UP)
+            m_warm_decal_allocations += m_last_decal_allocations;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Per decal scratch data comes from the frame arena and is handed back when the decal is done, so that any number of
+    // decals per frame reuse the same memory.
+    void apply_decal_with_arena(const glm::vec3& viewer_pos)
+    {
+        FrameArenaScope scope(m_frame_arena);
+        glm::vec4       uv_rect;
+
+        if (is_streaming_mesh())
+            require_chunks(m_global_uniforms.light_view_proj);
+
+        // Nothing to do if the projector does not touch the mesh.
+        if (!decal_uv_bounds(uv_rect))
+            return;
+
+        begin_history_edit();
+
+        int32_t lod = m_enable_decal_lod ? decal_lod(viewer_pos, m_hit_pos, m_projector_size) : 0;
+
+        // Without room to track it, the decal goes straight to mip 0.
+        if (lod > 0 && !reserve_lod_decal())
+            lod = 0;
+
+        // Refining restores the projector afterwards, but may have evicted the chunks under it.
+        if (refine_lod_decals(uv_rect, lod) && is_streaming_mesh())
+            require_chunks(m_global_uniforms.light_view_proj);
+
+        m_batch_has_decals = true;
+
+        write_decal(uv_rect, lod, m_headless);
+
+        if (lod > 0)
+            m_lod_decals.push_back({ save_projector_state(), uv_rect, lod, LOD_DECAL_STALE, m_history_batch, 0 });
+
+        m_last_decal_lod = lod;
+        m_decals_applied++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Writes the current decal into the given level of the atlas and rebuilds the coarser levels under it. Finer levels
+    // are left alone.
+    void write_decal(const glm::vec4& uv_rect, int32_t lod, bool timed)
+    {
+        capture_history_tiles(uv_rect, lod);
+
+        if (timed)
+            begin_pass_timer(m_depth_queries);
+
+        render_depth_map();
+
+        if (timed)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            begin_pass_timer(m_decal_queries);
+        }
+
+        uint64_t texels = 0;
+
+        glEnable(GL_SCISSOR_TEST);
+
+        if (lod == 0)
+        {
+            glm::ivec4 rect = texel_rect(uv_rect, 0);
+
+            m_atlas_fbo->bind();
+            glScissor(rect.x, rect.y, rect.z - rect.x, rect.w - rect.y);
+
+            render_decal(m_atlas_size, true);
+
+            texels += texel_rect_area(rect);
+        }
+        else
+            texels += write_decal_lod(uv_rect, lod);
+
+        glDisable(GL_SCISSOR_TEST);
+
+        texels += downsample_region(uv_rect, lod);
+
+        if (timed)
+            glEndQuery(GL_TIME_ELAPSED);
+
+        m_decal_texels_written += texels;
+        m_atlas_version++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    uint64_t write_decal_lod(const glm::vec4& uv_rect, int32_t lod)
+    {
+        glm::ivec4 rect = texel_rect(uv_rect, lod);
+        uint32_t   size = m_atlas_size >> lod;
+
+        // Rasterize the decal with its alpha into the matching level of the scratch textures (which start at mip 1).
+        glBindFramebuffer(GL_FRAMEBUFFER, m_lod_draw_fbo);
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, DECAL_CHANNEL_ATTACHMENTS[i], GL_TEXTURE_2D, m_scratch_textures[i]->id(), lod - 1);
+
+        glDrawBuffers(DECAL_CHANNEL_COUNT, DECAL_CHANNEL_ATTACHMENTS);
+        glScissor(rect.x, rect.y, rect.z - rect.x, rect.w - rect.y);
+
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        render_decal(size, false);
+
+        // Blend it into the selected level, keeping whatever was already there outside its alpha.
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+
+        set_decal_blend_state();
+
+        m_decal_composite_program->use();
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+        {
+            if (m_decal_composite_program->set_uniform(m_decal_sampler_names[i], i))
+                m_scratch_textures[i]->bind(i);
+        }
+
+        m_decal_composite_program->set_uniform("u_Level", float(lod - 1));
+        m_decal_composite_program->set_uniform("u_Rect", glm::vec4(rect) / float(size));
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, DECAL_CHANNEL_ATTACHMENTS[i], GL_TEXTURE_2D, m_atlas_textures[i]->id(), lod);
+
+        glViewport(rect.x, rect.y, rect.z - rect.x, rect.w - rect.y);
+
+        // Render fullscreen triangle
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDisable(GL_BLEND);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        return 3 * texel_rect_area(rect);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // A write at some level is followed by a downsample that rebuilds the coarser levels from it, which would drop the
+    // stale decals that only live in those levels. These are refined first, together with the stale decals that their
+    // own refinement would drop, oldest first so that newer decals stay on top. Returns whether anything was refined.
+    bool refine_lod_decals(const glm::vec4& uv_rect, int32_t level)
+    {
+        uint32_t count = uint32_t(m_lod_decals.size());
+
+        if (count == 0)
+            return false;
+
+        FrameArenaScope scope(m_frame_arena);
+        uint8_t*        selected      = m_frame_arena.allocate_array<uint8_t>(count);
+        uint32_t*       pending       = m_frame_arena.allocate_array<uint32_t>(count);
+        uint32_t        pending_count = 0;
+
+        memset(selected, 0, count);
+
+        select_lod_decals(uv_rect, level, selected, pending, pending_count);
+
+        // Refinements write mip 0, which in turn affects every stale decal under them.
+        for (uint32_t i = 0; i < pending_count; i++)
+            select_lod_decals(m_lod_decals[pending[i]].uv_rect, 0, selected, pending, pending_count);
+
+        if (pending_count == 0)
+            return false;
+
+        ProjectorState state = save_projector_state();
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (selected[i])
+                refine_lod_decal(m_lod_decals[i]);
+        }
+
+        restore_projector_state(state);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void select_lod_decals(const glm::vec4& uv_rect, int32_t level, uint8_t* selected, uint32_t* pending, uint32_t& pending_count)
+    {
+        for (uint32_t i = 0; i < m_lod_decals.size(); i++)
+        {
+            const LodDecal& decal = m_lod_decals[i];
+
+            if (selected[i] || decal.status != LOD_DECAL_STALE || decal.lod <= level)
+                continue;
+
+            // The downsample only drops the decal in the part of its own level that it rebuilds.
+            if (!texel_rects_overlap(texel_rect(decal.uv_rect, decal.lod), texel_rect(uv_rect, decal.lod)))
+                continue;
+
+            selected[i]              = 1;
+            pending[pending_count++] = i;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void refine_lod_decal(LodDecal& decal)
+    {
+        restore_projector_state(decal.state);
+
+        if (is_streaming_mesh())
+            require_chunks(m_global_uniforms.light_view_proj);
+
+        write_decal(decal.uv_rect, 0, false);
+
+        decal.status        = LOD_DECAL_REFINED;
+        decal.refined_batch = m_history_batch;
+
+        m_lod_refinements++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Refines the stale decals that the viewer has come close enough to for their missing levels to show. Refining is an
+    // edit, so it waits while there is something to redo rather than discarding it.
+    void refine_approached_lod_decals()
+    {
+        if (!m_redo_stack.empty())
+            return;
+
+        glm::vec3 viewer_pos = m_main_camera->m_position;
+        uint32_t  refined    = 0;
+
+        for (uint32_t i = 0; i < m_lod_decals.size() && refined < LOD_REFINEMENTS_PER_FRAME; i++)
+        {
+            const LodDecal& decal = m_lod_decals[i];
+
+            if (decal.status != LOD_DECAL_STALE || decal_lod(viewer_pos, decal.state.hit_pos, decal.state.projector_size) >= decal.lod)
+                continue;
+
+            if (refine_lod_decals(decal.uv_rect, 0))
+                refined++;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Follows the decals written to coarse levels only through an undo or redo of the given batch. The atlas itself is
+    // restored by the history tiles, which include the coarse levels.
+    void step_lod_decals(uint32_t batch, bool undoing)
+    {
+        for (LodDecal& decal : m_lod_decals)
+        {
+            if (decal.created_batch == batch)
+                decal.status = undoing ? LOD_DECAL_UNDONE : (decal.refined_batch == batch ? LOD_DECAL_REFINED : LOD_DECAL_STALE);
+            else if (decal.refined_batch == batch)
+                decal.status = undoing ? LOD_DECAL_STALE : LOD_DECAL_REFINED;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Refined decals only need tracking while the steps that could make them stale again are still in the history.
+    bool reserve_lod_decal()
+    {
+        if (m_lod_decals.size() < LOD_DECAL_CAPACITY)
+            return true;
+
+        uint32_t oldest = m_undo_batches.empty() ? m_history_batch : m_undo_batches.front().serial;
+
+        m_lod_decals.erase(std::remove_if(m_lod_decals.begin(), m_lod_decals.end(), [oldest](const LodDecal& decal) { return decal.status == LOD_DECAL_REFINED && decal.refined_batch < oldest; }), m_lod_decals.end());
+
+        return m_lod_decals.size() < LOD_DECAL_CAPACITY;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    uint32_t stale_lod_decal_count()
+    {
+        uint32_t count = 0;
+
+        for (const LodDecal& decal : m_lod_decals)
+            count += decal.status == LOD_DECAL_STALE ? 1 : 0;
+
+        return count;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool texel_rects_overlap(const glm::ivec4& a, const glm::ivec4& b)
+    {
+        return a.x < b.z && b.x < a.z && a.y < b.w && b.y < a.w;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    uint64_t downsample_region(const glm::vec4& uv_rect, int32_t base_level)
+    {
+        uint64_t texels = 0;
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_lod_read_fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_lod_draw_fbo);
+
+        // Blits copy a single read buffer, so go through the channels one at a time.
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+        // A 2:1 linear blit samples exactly between four source texels, which makes it a 2x2 box filter.
+        for (int32_t level = base_level + 1; level < m_albedo_mip_levels; level++)
+        {
+            glm::ivec4 dst = texel_rect(uv_rect, level);
+            glm::ivec4 src = dst * 2;
+
+            for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            {
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_atlas_textures[i]->id(), level - 1);
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_atlas_textures[i]->id(), level);
+
+                glBlitFramebuffer(src.x, src.y, src.z, src.w, dst.x, dst.y, dst.z, dst.w, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            }
+
+            texels += texel_rect_area(dst);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        return texels;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void init_history()
+    {
+        uint32_t grid = m_atlas_size / HISTORY_TILE_SIZE;
+
+        // Tiles hold every level down to a single texel, as decals written to a coarse level only exist there.
+        m_history_tile_levels = std::min(HISTORY_TILE_LEVELS, m_albedo_mip_levels);
+        m_history_tile_bytes  = 0;
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            m_history_tile_bytes += history_channel_bytes(i);
+
+        m_tile_captured.assign(grid * grid, false);
+        m_history_tile_data.resize(m_history_tile_bytes);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void reset_history()
+    {
+        end_history_batch();
+
+        for (auto& readback : m_pending_readbacks)
+        {
+            glDeleteSync(readback.fence);
+            m_free_pbos.insert(m_free_pbos.end(), readback.pbos.begin(), readback.pbos.end());
+            release_history_readback(readback);
+        }
+
+        m_pending_readbacks.clear();
+        m_undo_stack.clear();
+        m_redo_stack.clear();
+        m_undo_batches.clear();
+        m_redo_batches.clear();
+        m_lod_decals.clear();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    size_t history_channel_bytes(uint32_t channel)
+    {
+        size_t bytes = 0;
+
+        for (int32_t level = 0; level < m_history_tile_levels; level++)
+            bytes += size_t(HISTORY_TILE_SIZE >> level) * size_t(HISTORY_TILE_SIZE >> level) * DECAL_CHANNELS[channel].pixel_size;
+
+        return bytes;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // A new edit invalidates whatever was undone before it, including the decals that only the redo steps still hold.
+    void begin_history_edit()
+    {
+        if (m_redo_stack.empty() && m_redo_batches.empty())
+            return;
+
+        m_redo_stack.clear();
+        m_redo_batches.clear();
+
+        m_lod_decals.erase(std::remove_if(m_lod_decals.begin(), m_lod_decals.end(), [](const LodDecal& decal) { return decal.status == LOD_DECAL_UNDONE; }), m_lod_decals.end());
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    GLuint acquire_history_pbo()
+    {
+        GLuint pbo;
+
+        if (!m_free_pbos.empty())
+        {
+            pbo = m_free_pbos.back();
+            m_free_pbos.pop_back();
+        }
+        else
+        {
+            glGenBuffers(1, &pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, HISTORY_TILES_PER_READBACK * m_history_tile_bytes, nullptr, GL_STREAM_READ);
+        }
+
+        return pbo;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    glm::vec4 history_tile_uv_rect(uint32_t x, uint32_t y)
+    {
+        return glm::vec4(x, y, x + 1, y + 1) * (float(HISTORY_TILE_SIZE) / float(m_atlas_size));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Captures every tile under the texels that a write to the given level may touch.
+    void capture_history_tiles(const glm::vec4& uv_rect, int32_t level)
+    {
+        glm::ivec4 rect = glm::min(texel_rect(uv_rect, level) * (1 << level), glm::ivec4(int32_t(m_atlas_size)));
+        uint32_t   grid = m_atlas_size / HISTORY_TILE_SIZE;
+
+        if (rect.z <= rect.x || rect.w <= rect.y)
+            return;
+
+        int32_t first_x = rect.x / HISTORY_TILE_SIZE;
+        int32_t first_y = rect.y / HISTORY_TILE_SIZE;
+        int32_t last_x  = (rect.z - 1) / HISTORY_TILE_SIZE;
+        int32_t last_y  = (rect.w - 1) / HISTORY_TILE_SIZE;
+
+        // Only the first decal of a batch touching a tile needs its before-image.
+        ArenaArray<uint32_t> new_tiles(m_frame_arena, size_t(last_x - first_x + 1) * size_t(last_y - first_y + 1));
+
+        for (int32_t y = first_y; y <= last_y; y++)
+        {
+            for (int32_t x = first_x; x <= last_x; x++)
+            {
+                uint32_t tile = y * grid + x;
+
+                if (!m_tile_captured[tile])
+                {
+                    m_tile_captured[tile] = true;
+                    new_tiles.push_back(tile);
+                }
+            }
+        }
+
+        if (new_tiles.empty())
+            return;
+
+        size_t first = m_open_readback.tiles.size();
+
+        m_open_readback.tiles.insert(m_open_readback.tiles.end(), new_tiles.begin(), new_tiles.end());
+
+        while (m_open_readback.pbos.size() * HISTORY_TILES_PER_READBACK < m_open_readback.tiles.size())
+            m_open_readback.pbos.push_back(acquire_history_pbo());
+
+        // Copy the tiles into pixel pack buffers. This is queued ahead of the decal draws, so it sees the atlas as it
+        // was before them, and is only mapped once its fence has signaled in a later frame.
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_lod_read_fbo);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+        size_t channel_offset = 0;
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+        {
+            const DecalChannelDesc& channel = DECAL_CHANNELS[i];
+
+            for (int32_t level = 0; level < m_history_tile_levels; level++)
+            {
+                int32_t size = HISTORY_TILE_SIZE >> level;
+
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_atlas_textures[i]->id(), level);
+
+                for (size_t j = first; j < m_open_readback.tiles.size(); j++)
+                {
+                    uint32_t tile   = m_open_readback.tiles[j];
+                    size_t   offset = (j % HISTORY_TILES_PER_READBACK) * m_history_tile_bytes + channel_offset;
+
+                    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_open_readback.pbos[j / HISTORY_TILES_PER_READBACK]);
+                    glReadPixels((tile % grid) * size, (tile / grid) * size, size, size, channel.format, GL_UNSIGNED_BYTE, (void*)offset);
+                }
+
+                channel_offset += size_t(size) * size_t(size) * channel.pixel_size;
+            }
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_history_batch()
+    {
+        if (m_open_readback.tiles.empty())
+            return;
+
+        for (uint32_t tile : m_open_readback.tiles)
+            m_tile_captured[tile] = false;
+
+        m_open_readback.fence           = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_open_readback.batch           = m_history_batch++;
+        m_open_readback.refinement_only = !m_batch_has_decals;
+
+        m_pending_readbacks.push_back(std::move(m_open_readback));
+        m_open_readback    = acquire_history_readback();
+        m_batch_has_decals = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Readbacks are recycled so that the tile and buffer lists keep their capacity from batch to batch.
+    HistoryReadback acquire_history_readback()
+    {
+        if (m_free_readbacks.empty())
+            return HistoryReadback();
+
+        HistoryReadback readback = std::move(m_free_readbacks.back());
+        m_free_readbacks.pop_back();
+
+        return readback;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void release_history_readback(HistoryReadback& readback)
+    {
+        readback.pbos.clear();
+        readback.tiles.clear();
+        readback.fence = nullptr;
+
+        m_free_readbacks.push_back(std::move(readback));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void resolve_history_readbacks(bool wait)
+    {
+        uint32_t grid = m_atlas_size / HISTORY_TILE_SIZE;
+
+        while (!m_pending_readbacks.empty())
+        {
+            HistoryReadback& readback = m_pending_readbacks.front();
+
+            if (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? UINT64_MAX : 0) == GL_TIMEOUT_EXPIRED)
+                break;
+
+            glDeleteSync(readback.fence);
+
+            m_history_blob.clear();
+            m_history_tiles.clear();
+
+            for (size_t i = 0; i < readback.pbos.size(); i++)
+            {
+                size_t first = i * HISTORY_TILES_PER_READBACK;
+                size_t last  = std::min(first + HISTORY_TILES_PER_READBACK, readback.tiles.size());
+
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbos[i]);
+
+                const uint8_t* data = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (last - first) * m_history_tile_bytes, GL_MAP_READ_BIT);
+
+                if (data)
+                {
+                    for (size_t j = first; j < last; j++)
+                        append_history_tile(readback.tiles[j] % grid, readback.tiles[j] / grid, data + (j - first) * m_history_tile_bytes);
+
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+
+                m_free_pbos.push_back(readback.pbos[i]);
+            }
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            m_last_step_tiles     = uint32_t(m_history_tiles.size());
+            m_last_step_bytes     = m_history_blob.size();
+            m_last_step_raw_bytes = m_history_tiles.size() * m_history_tile_bytes;
+
+            if (m_undo_stack.push(m_history_blob.data(), m_history_blob.size(), m_last_step_raw_bytes, m_history_tiles))
+                push_history_batch(m_undo_batches, m_undo_stack, { readback.batch, readback.refinement_only });
+            else
+                DW_LOG_WARNING("Decal batch too large for the undo history");
+
+            release_history_readback(readback);
+            m_pending_readbacks.pop_front();
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void append_history_tile(uint32_t x, uint32_t y, const uint8_t* data)
+    {
+        size_t offset = m_history_blob.size();
+        size_t size   = 0;
+
+        m_history_blob.resize(offset + tile_encode_bound(m_history_tile_bytes) + DECAL_CHANNEL_COUNT);
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+        {
+            size_t channel_bytes = history_channel_bytes(i);
+
+            size += tile_encode(data, channel_bytes, DECAL_CHANNELS[i].pixel_size, &m_history_blob[offset + size]);
+            data += channel_bytes;
+        }
+
+        m_history_blob.resize(offset + size);
+        m_history_tiles.push_back({ uint16_t(x), uint16_t(y), uint32_t(offset), uint32_t(size) });
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Pushes the batch of a step that was just pushed, dropping those of the steps the stack evicted to make room.
+    void push_history_batch(std::deque<HistoryBatch>& batches, const HistoryStack& stack, const HistoryBatch& batch)
+    {
+        batches.push_back(batch);
+
+        while (batches.size() > stack.step_count())
+            batches.pop_front();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Refinements only make decals sharper, so undo steps over the ones made since the last edit before undoing it, and
+    // redo brings them back along with it.
+    void undo()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // Make sure the latest decals have made it into the history.
+        end_history_batch();
+        resolve_history_readbacks(true);
+
+        while (!m_undo_batches.empty() && m_undo_batches.back().refinement_only)
+            step_history(m_undo_stack, m_redo_stack, m_undo_batches, m_redo_batches, true);
+
+        step_history(m_undo_stack, m_redo_stack, m_undo_batches, m_redo_batches, true);
+
+        finish_history_step(start);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void redo()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        end_history_batch();
+        resolve_history_readbacks(true);
+
+        if (step_history(m_redo_stack, m_undo_stack, m_redo_batches, m_undo_batches, false))
+        {
+            while (!m_redo_batches.empty() && m_redo_batches.back().refinement_only)
+                step_history(m_redo_stack, m_undo_stack, m_redo_batches, m_undo_batches, false);
+        }
+
+        finish_history_step(start);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void finish_history_step(std::chrono::high_resolution_clock::time_point start)
+    {
+        glFinish();
+
+        m_last_undo_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        m_atlas_version++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool step_history(HistoryStack& from, HistoryStack& to, std::deque<HistoryBatch>& from_batches, std::deque<HistoryBatch>& to_batches, bool undoing)
+    {
+        HistoryStep step;
+
+        if (!from.pop(m_history_step_data, step))
+            return false;
+
+        HistoryBatch batch = from_batches.back();
+        from_batches.pop_back();
+
+        m_history_blob.clear();
+        m_history_tiles.clear();
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_lod_read_fbo);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        for (const HistoryTile& tile : step.tiles)
+        {
+            uint8_t*       data   = m_history_tile_data.data();
+            const uint8_t* stored = m_history_step_data.data() + tile.offset;
+            size_t         left   = tile.size;
+
+            // Keep the current contents of the tile so the step can be reversed again.
+            for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            {
+                for (int32_t level = 0; level < m_history_tile_levels; level++)
+                {
+                    int32_t size = HISTORY_TILE_SIZE >> level;
+
+                    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_atlas_textures[i]->id(), level);
+                    glReadPixels(tile.x * size, tile.y * size, size, size, DECAL_CHANNELS[i].format, GL_UNSIGNED_BYTE, data);
+
+                    data += size_t(size) * size_t(size) * DECAL_CHANNELS[i].pixel_size;
+                }
+            }
+
+            append_history_tile(tile.x, tile.y, m_history_tile_data.data());
+
+            // Upload the stored contents, touching nothing outside the tile.
+            data = m_history_tile_data.data();
+
+            for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+            {
+                size_t channel_bytes = history_channel_bytes(i);
+                size_t consumed      = tile_decode(stored, left, DECAL_CHANNELS[i].pixel_size, data, channel_bytes);
+
+                m_atlas_textures[i]->bind(0);
+
+                for (int32_t level = 0; level < m_history_tile_levels; level++)
+                {
+                    int32_t size = HISTORY_TILE_SIZE >> level;
+
+                    glTexSubImage2D(GL_TEXTURE_2D, level, tile.x * size, tile.y * size, size, size, DECAL_CHANNELS[i].format, GL_UNSIGNED_BYTE, data);
+
+                    data += size_t(size) * size_t(size) * DECAL_CHANNELS[i].pixel_size;
+                }
+
+                stored += consumed;
+                left -= consumed;
+            }
+        }
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // Rebuild the levels below a single texel per tile from the restored tiles only.
+        for (const HistoryTile& tile : step.tiles)
+            downsample_region(history_tile_uv_rect(tile.x, tile.y), m_history_tile_levels - 1);
+
+        if (to.push(m_history_blob.data(), m_history_blob.size(), m_history_tiles.size() * m_history_tile_bytes, m_history_tiles))
+            push_history_batch(to_batches, to, batch);
+        else
+            DW_LOG_WARNING("Decal batch too large for the undo history");
+
+        step_lod_decals(batch.serial, undoing);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool decal_uv_bounds(glm::vec4& uv_rect)
+    {
+        glm::mat4 view_proj = m_global_uniforms.light_view_proj * m_transform;
+        UvBounds  bounds;
+
+        if (is_streaming_mesh())
+        {
+            const std::vector<MeshChunkDesc>& descs = m_chunk_file.chunks();
+
+            // Only chunks under the projector can contribute, and require_chunks() made all of them resident.
+            for (uint32_t i = 0; i < descs.size(); i++)
+            {
+                StreamedChunk& chunk = m_chunks[i];
+
+                if (chunk.state != CHUNK_RESIDENT || !chunk_overlaps(view_proj, descs[i]))
+                    continue;
+
+                FrameArenaScope  scope(m_frame_arena);
+                const glm::vec3* clip_positions = project_decal_vertices(view_proj, chunk.data.vertices.data(), uint32_t(chunk.data.vertices.size()));
+
+                gather_decal_uv_bounds(chunk.data.vertices.data(), clip_positions, chunk.data.indices.data(), uint32_t(chunk.data.indices.size()), 0, bounds);
+            }
+        }
+        else
+        {
+            dw::SubMesh*     submeshes      = m_mesh->sub_meshes();
+            const glm::vec3* clip_positions = project_decal_vertices(view_proj, m_mesh->vertices(), m_mesh->vertex_count());
+
+            for (uint32_t i = 0; i < m_mesh->sub_mesh_count(); i++)
+            {
+                dw::SubMesh& submesh = submeshes[i];
+                gather_decal_uv_bounds(m_mesh->vertices(), clip_positions, m_mesh->indices() + submesh.base_index, submesh.index_count, submesh.base_vertex, bounds);
+            }
+        }
+
+        uv_rect = glm::clamp(glm::vec4(bounds.uv_min, bounds.uv_max), glm::vec4(0.0f), glm::vec4(1.0f));
+
+        return bounds.found;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Returns the clip space positions in frame arena memory.
+    template <typename VertexType>
+    const glm::vec3* project_decal_vertices(const glm::mat4& view_proj, const VertexType* vertices, uint32_t vertex_count)
+    {
+        glm::vec3* clip_positions = m_frame_arena.allocate_array<glm::vec3>(vertex_count);
+
+        // The projector is orthographic so w stays 1.
+        m_scheduler.parallel_for(vertex_count, TASK_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+                clip_positions[i] = glm::vec3(view_proj * glm::vec4(vertex_position(vertices[i]), 1.0f));
+        });
+
+        return clip_positions;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    template <typename VertexType>
+    void gather_decal_uv_bounds(const VertexType* vertices, const glm::vec3* clip_positions, const uint32_t* indices, uint32_t index_count, uint32_t base_vertex, UvBounds& bounds)
+    {
+        std::mutex merge_mutex;
+
+        // Each chunk of triangles gathers its own bounds, which are merged at the end.
+        m_scheduler.parallel_for(index_count / 3, TASK_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+            glm::vec2 chunk_min   = glm::vec2(1.0f);
+            glm::vec2 chunk_max   = glm::vec2(0.0f);
+            bool      chunk_found = false;
+
+            for (uint32_t j = begin * 3; j < end * 3; j += 3)
+            {
+                uint32_t v0 = base_vertex + indices[j];
+                uint32_t v1 = base_vertex + indices[j + 1];
+                uint32_t v2 = base_vertex + indices[j + 2];
+
+                glm::vec3 clip_min = glm::min(clip_positions[v0], glm::min(clip_positions[v1], clip_positions[v2]));
+                glm::vec3 clip_max = glm::max(clip_positions[v0], glm::max(clip_positions[v1], clip_positions[v2]));
+
+                if (glm::any(glm::greaterThan(clip_min, glm::vec3(1.0f))) || glm::any(glm::lessThan(clip_max, glm::vec3(-1.0f))))
+                    continue;
+
+                glm::vec2 uv0 = vertex_tex_coord(vertices[v0]);
+                glm::vec2 uv1 = vertex_tex_coord(vertices[v1]);
+                glm::vec2 uv2 = vertex_tex_coord(vertices[v2]);
+
+                chunk_min   = glm::min(chunk_min, glm::min(uv0, glm::min(uv1, uv2)));
+                chunk_max   = glm::max(chunk_max, glm::max(uv0, glm::max(uv1, uv2)));
+                chunk_found = true;
+            }
+
+            if (chunk_found)
+            {
+                std::lock_guard<std::mutex> lock(merge_mutex);
+
+                bounds.uv_min = glm::min(bounds.uv_min, chunk_min);
+                bounds.uv_max = glm::max(bounds.uv_max, chunk_max);
+                bounds.found  = true;
+            }
+        });
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    glm::ivec4 texel_rect(const glm::vec4& uv_rect, int32_t level)
+    {
+        int32_t size = int32_t(m_atlas_size >> level);
+
+        // Pad by a texel on each side to cover conservative rasterization and the bilinear footprint.
+        return glm::ivec4(glm::clamp(int32_t(floorf(uv_rect.x * size)) - 1, 0, size),
+                          glm::clamp(int32_t(floorf(uv_rect.y * size)) - 1, 0, size),
+                          glm::clamp(int32_t(ceilf(uv_rect.z * size)) + 1, 0, size),
+                          glm::clamp(int32_t(ceilf(uv_rect.w * size)) + 1, 0, size));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    uint64_t texel_rect_area(const glm::ivec4& rect)
+    {
+        return uint64_t(rect.z - rect.x) * uint64_t(rect.w - rect.y);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    int32_t decal_lod(const glm::vec3& viewer_pos, const glm::vec3& hit_pos, float projector_size)
+    {
+        // Width of the decal in atlas texels at mip 0, and in pixels on screen as seen from the viewer.
+        float atlas_texels  = 2.0f * projector_size * m_texel_density;
+        float distance      = glm::max(glm::length(viewer_pos - hit_pos), 0.1f);
+        float screen_pixels = projector_size / (distance * tanf(glm::radians(CAMERA_FOV * 0.5f))) * float(m_height);
+
+        // Never go so coarse that the decal itself collapses into a handful of texels.
+        float lod     = log2f(atlas_texels / glm::max(screen_pixels, 1.0f)) + m_decal_lod_bias;
+        float max_lod = log2f(glm::max(atlas_texels / DECAL_LOD_MIN_TEXELS, 1.0f));
+
+        return glm::clamp(int32_t(floorf(glm::min(lod, max_lod))), 0, m_albedo_mip_levels - 1);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void benchmark_distant_impacts()
+    {
+        ProjectorState state      = save_projector_state();
+        bool           enable_lod = m_enable_decal_lod;
+
+        for (uint32_t mode = 0; mode < 2; mode++)
+        {
+            init_texture();
+
+            // Both modes rebuild only the mips under each decal, so they differ in the level the decal is written to.
+            m_enable_decal_lod     = mode == 0;
+            m_decal_texels_written = 0;
+            m_decals_applied       = 0;
+
+            std::mt19937                          gen(1337);
+            std::uniform_real_distribution<float> unit_dis(-1.0f, 1.0f);
+            std::uniform_real_distribution<float> scale_dis(5.0, 20.0);
+            std::uniform_real_distribution<float> rotation_dis(-90.0, 90.0);
+            std::uniform_int_distribution<>       index_dis(0, 3);
+
+            GLuint query;
+            glGenQueries(1, &query);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+
+            // Impacts observed from the point they were fired from, far away from the mesh.
+            for (uint32_t i = 0; i < DISTANT_IMPACT_COUNT; i++)
+            {
+                glm::vec3 origin = glm::normalize(glm::vec3(unit_dis(gen), unit_dis(gen) * 0.5f, unit_dis(gen))) * DISTANT_IMPACT_DISTANCE;
+                glm::vec3 target = glm::vec3(unit_dis(gen), unit_dis(gen), unit_dis(gen)) * 20.0f;
+
+                m_selected_decal     = index_dis(gen);
+                m_projector_size     = scale_dis(gen);
+                m_projector_rotation = rotation_dis(gen);
+
+                if (!place_decal(origin, glm::normalize(target - origin)))
+                    continue;
+
+                update_transforms(m_main_camera.get());
+                update_global_uniforms(m_global_uniforms);
+
+                apply_decal(origin);
+            }
+
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            glDeleteQueries(1, &query);
+
+            m_distant_impact_texels[mode] = m_decals_applied > 0 ? double(m_decal_texels_written) / double(m_decals_applied) : 0.0;
+            m_distant_impact_ms[mode]     = double(elapsed) / 1000000.0;
+        }
+
+        m_distant_impact_benchmarked = true;
+        m_enable_decal_lod           = enable_lod;
+        m_decal_texels_written       = 0;
+        m_decals_applied             = 0;
+        m_lod_refinements            = 0;
+
+        init_texture();
+        restore_projector_state(state);
+
+        DW_LOG_INFO("Distant Impact Benchmark: LOD = " + std::to_string(m_distant_impact_texels[0]) + " texels/decal (" + std::to_string(m_distant_impact_ms[0]) + " ms), Mip 0 = " + std::to_string(m_distant_impact_texels[1]) + " texels/decal (" + std::to_string(m_distant_impact_ms[1]) + " ms)");
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_headless_run()
+    {
+#if !defined(GLFW_PLATFORM_NULL)
+        // Without GLFW's null platform a display is still required, but the window is never shown.
+        glfwHideWindow(m_window);
+#endif
+
+        m_debug_gui        = false;
+        m_render_on_demand = false;
+        m_headless_target  = g_launch_options.decals;
+        m_run_start        = std::chrono::high_resolution_clock::now();
+
+        m_headless_rng.seed(HEADLESS_SEED);
+
+        // Keeps the timer lists from growing in the middle of the run.
+        m_depth_queries.reserve(m_headless_target);
+        m_decal_queries.reserve(m_headless_target);
+
+        DW_LOG_INFO("Headless run on " + std::string((const char*)glGetString(GL_RENDERER)) + ": " + std::to_string(g_launch_options.frames) + " frames, " + std::to_string(m_headless_target) + " decals (" + std::to_string(g_launch_options.decals_per_frame) + " per frame)");
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void apply_headless_decals()
+    {
+        if (m_headless_decals >= m_headless_target)
+            return;
+
+        std::uniform_real_distribution<float> target_dis(-20.0f, 20.0f);
+        std::uniform_real_distribution<float> scale_dis(5.0, 20.0);
+        std::uniform_real_distribution<float> rotation_dis(-90.0, 90.0);
+        std::uniform_int_distribution<>       index_dis(0, int32_t(m_decal_assets.size()) - 1);
+
+        ProjectorState state = save_projector_state();
+
+        for (uint32_t i = 0; i < g_launch_options.decals_per_frame && m_headless_decals < m_headless_target; i++)
+        {
+            glm::vec3 origin = m_main_camera->m_position;
+            bool      hit    = false;
+
+            // Aim at random points around the mesh, which the camera faces from its start position. The components are
+            // drawn one at a time so that the sequence does not depend on argument evaluation order.
+            for (uint32_t attempt = 0; attempt < HEADLESS_MAX_ATTEMPTS && !hit; attempt++)
+            {
+                float x = target_dis(m_headless_rng);
+                float y = target_dis(m_headless_rng);
+                float z = target_dis(m_headless_rng);
+
+                hit = place_decal(origin, glm::normalize(glm::vec3(x, y, z) - origin));
+            }
+
+            if (!hit)
+            {
+                DW_LOG_WARNING("Headless run: no surface to place decals on, stopping at " + std::to_string(m_headless_decals) + " decals");
+                m_headless_target = m_headless_decals;
+                break;
+            }
+
+            m_selected_decal     = index_dis(m_headless_rng);
+            m_projector_size     = scale_dis(m_headless_rng);
+            m_projector_rotation = rotation_dis(m_headless_rng);
+
+            update_transforms(m_main_camera.get());
+            update_global_uniforms(m_global_uniforms);
+
+            apply_decal(origin);
+
+            m_headless_decals++;
+        }
+
+        restore_projector_state(state);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_headless_frame()
+    {
+        // Wait for the GPU so that the frame time covers all of the frame's work.
+        glFinish();
+
+        m_frame_times_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_frame_start).count());
+        m_headless_frames++;
+
+        if (m_headless_frames >= g_launch_options.frames && m_headless_decals >= m_headless_target)
+            finish_headless_run();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_pass_timer(std::vector<GLuint>& queries)
+    {
+        GLuint query;
+
+        glGenQueries(1, &query);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+
+        queries.push_back(query);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void resolve_pass_timers(std::vector<GLuint>& queries, double& total_ms, double& max_ms)
+    {
+        total_ms = 0.0;
+        max_ms   = 0.0;
+
+        for (GLuint query : queries)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+            total_ms += double(elapsed) / 1000000.0;
+            max_ms = std::max(max_ms, double(elapsed) / 1000000.0);
+        }
+
+        glDeleteQueries(GLsizei(queries.size()), queries.data());
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void finish_headless_run()
+    {
+        double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_run_start).count();
+        double depth_total_ms, depth_max_ms, decal_total_ms, decal_max_ms;
+
+        resolve_pass_timers(m_depth_queries, depth_total_ms, depth_max_ms);
+        resolve_pass_timers(m_decal_queries, decal_total_ms, decal_max_ms);
+
+        uint32_t            timed_decals = uint32_t(m_decal_queries.size());
+        std::vector<double> frame_times  = m_frame_times_ms;
+
+        std::sort(frame_times.begin(), frame_times.end());
+
+        double frame_avg_ms = 0.0;
+
+        for (double ms : frame_times)
+            frame_avg_ms += ms;
+
+        frame_avg_ms /= double(frame_times.size());
+
+        double      frame_p50_ms = frame_times[frame_times.size() / 2];
+        double      frame_p95_ms = frame_times[std::min(frame_times.size() * 95 / 100, frame_times.size() - 1)];
+        double      frame_max_ms = frame_times.back();
+        double      depth_avg_ms = timed_decals > 0 ? depth_total_ms / timed_decals : 0.0;
+        double      decal_avg_ms = timed_decals > 0 ? decal_total_ms / timed_decals : 0.0;
+        std::string renderer     = (const char*)glGetString(GL_RENDERER);
+
+        DW_LOG_INFO("Headless run finished on " + renderer + " in " + std::to_string(wall_ms) + " ms: " + std::to_string(m_headless_frames) + " frames, " + std::to_string(timed_decals) + " decals");
+        DW_LOG_INFO("Frame            : avg " + std::to_string(frame_avg_ms) + " ms, p50 " + std::to_string(frame_p50_ms) + " ms, p95 " + std::to_string(frame_p95_ms) + " ms, max " + std::to_string(frame_max_ms) + " ms");
+        DW_LOG_INFO("render_depth_map : avg " + std::to_string(depth_avg_ms) + " ms, max " + std::to_string(depth_max_ms) + " ms, total " + std::to_string(depth_total_ms) + " ms");
+        DW_LOG_INFO("apply_decal      : avg " + std::to_string(decal_avg_ms) + " ms, max " + std::to_string(decal_max_ms) + " ms, total " + std::to_string(decal_total_ms) + " ms");
+        DW_LOG_INFO("Heap allocations : " + std::to_string(m_warm_decal_allocations) + " after the first " + std::to_string(DECAL_ALLOCATION_WARM_UP) + " decals, frame arena peak " + std::to_string(m_frame_arena.peak()) + " bytes");
+
+        if (!g_launch_options.report_path.empty())
+        {
+            std::ofstream report(g_launch_options.report_path);
+
+            report << "{\n";
+            report << "    \"renderer\": \"" << renderer << "\",\n";
+            report << "    \"frames\": " << m_headless_frames << ",\n";
+            report << "    \"decals\": " << timed_decals << ",\n";
+            report << "    \"atlas_size\": " << m_atlas_size << ",\n";
+            report << "    \"threads\": " << m_scheduler.thread_count() << ",\n";
+            report << "    \"decal_lod\": " << (m_enable_decal_lod ? "true" : "false") << ",\n";
+            report << "    \"lod_refinements\": " << m_lod_refinements << ",\n";
+            report << "    \"mesh\": \"" << g_launch_options.mesh_path << "\",\n";
+            report << "    \"peak_rss_mb\": " << double(peak_rss_bytes()) / (1024.0 * 1024.0) << ",\n";
+            report << "    \"wall_ms\": " << wall_ms << ",\n";
+            report << "    \"frame_ms\": { \"avg\": " << frame_avg_ms << ", \"p50\": " << frame_p50_ms << ", \"p95\": " << frame_p95_ms << ", \"max\": " << frame_max_ms << " },\n";
+            report << "    \"render_depth_map_ms\": { \"avg\": " << depth_avg_ms << ", \"max\": " << depth_max_ms << ", \"total\": " << depth_total_ms << " },\n";
+            report << "    \"apply_decal_ms\": { \"avg\": " << decal_avg_ms << ", \"max\": " << decal_max_ms << ", \"total\": " << decal_total_ms << " },\n";
+            report << "    \"warm_decal_heap_allocations\": " << m_warm_decal_allocations << ",\n";
+            report << "    \"frame_arena_bytes\": " << m_frame_arena.capacity() << "\n";
+            report << "}\n";
+
+            if (!report)
+                DW_LOG_WARNING("Failed to write report to " + g_launch_options.report_path);
+        }
+
+        if (!g_launch_options.dump_prefix.empty())
+        {
+            std::vector<uint8_t> pixels(size_t(m_width) * size_t(m_height) * 3);
+
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            glReadBuffer(GL_BACK);
+            glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+            write_ppm(g_launch_options.dump_prefix + "_frame.ppm", m_width, m_height, pixels);
+
+            pixels.resize(size_t(m_atlas_size) * size_t(m_atlas_size) * 3);
+
+            m_atlas_textures[DECAL_CHANNEL_ALBEDO]->bind(0);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+            write_ppm(g_launch_options.dump_prefix + "_atlas.ppm", m_atlas_size, m_atlas_size, pixels);
+
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        }
+
+        // Stop here, the frame loop exits before the next update.
+        m_headless = false;
+        glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void write_ppm(const std::string& path, int32_t w, int32_t h, const std::vector<uint8_t>& rgb)
+    {
+        std::ofstream file(path, std::ios::binary);
+
+        file << "P6\n"
+             << w << " " << h << "\n255\n";
+
+        // GL images start at the bottom row.
+        for (int32_t y = h - 1; y >= 0; y--)
+            file.write((const char*)&rgb[size_t(y) * size_t(w) * 3], w * 3);
+
+        if (!file)
+            DW_LOG_WARNING("Failed to write " + path);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_depth_map()
+    {
+        render_scene(m_depth_fbo.get(), m_depth_program, uv_pass_vertex_array(), m_global_uniforms.light_view_proj, 0, 0, DEPTH_TEXTURE_SIZE, DEPTH_TEXTURE_SIZE, GL_BACK);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_lit_scene(dw::Framebuffer* fbo)
+    {
+        render_scene(fbo, m_mesh_program, mesh_vertex_array(), m_global_uniforms.view_proj, 0, 0, m_width, m_height, GL_BACK);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_frame(dw::Framebuffer* fbo)
+    {
+        render_lit_scene(fbo);
+
+        if (m_visualize_albedo_map)
+            visualize_albedo_map();
+
+        if (m_hit_distance != INFINITY)
+        {
+            if (m_visualize_hit_point)
+                m_debug_draw.sphere(2.0f, m_hit_pos, glm::vec3(1.0f, 0.0f, 0.0f));
+
+            if (m_visualize_projection_frustum)
+                m_debug_draw.frustum(m_global_uniforms.light_view_proj, glm::vec3(0.0f, 1.0f, 0.0f));
+
+            if (m_visualize_hit_point || m_visualize_projection_frustum)
+                m_debug_draw.render(fbo, m_width, m_height, m_global_uniforms.view_proj);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void present_cached_frame()
+    {
+        m_scene_fbo->bind();
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+        glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    FrameState current_frame_state()
+    {
+        FrameState state;
+
+        state.view_proj                    = m_global_uniforms.view_proj;
+        state.light_view_proj              = m_global_uniforms.light_view_proj;
+        state.cam_pos                      = m_global_uniforms.cam_pos;
+        state.hit_pos                      = m_hit_pos;
+        state.has_hit                      = m_hit_distance != INFINITY;
+        state.width                        = m_width;
+        state.height                       = m_height;
+        state.atlas_version                = m_atlas_version;
+        state.geometry_version             = m_geometry_version;
+        state.visualize_albedo_map         = m_visualize_albedo_map;
+        state.visualized_channel           = m_visualized_channel;
+        state.visualize_hit_point          = m_visualize_hit_point;
+        state.visualize_projection_frustum = m_visualize_projection_frustum;
+
+        return state;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void visualize_albedo_map()
+    {
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+
+        glViewport(0, 0, 512, 512);
+
+        // Bind shader program.
+        m_visualize_program->use();
+
+        if (m_visualize_program->set_uniform("s_Texture", 0))
+            m_atlas_textures[m_visualized_channel]->bind(0);
+
+        // Render fullscreen triangle
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool create_shaders()
+    {
+        {
+            // Create general shaders
+            m_uv_space_vs      = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/uv_space_vs.glsl"));
+            m_texture_init_fs  = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/texture_init_fs.glsl"));
+            m_decal_project_fs = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/decal_project_fs.glsl"));
+            m_mesh_vs          = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/mesh_vs.glsl"));
+            m_mesh_fs          = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/mesh_fs.glsl"));
+            m_triangle_vs      = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/fullscreen_triangle_vs.glsl"));
+            m_visualize_fs     = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/visualize_albedo_fs.glsl"));
+            m_depth_vs         = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_VERTEX_SHADER, "shader/depth_vs.glsl"));
+            m_depth_fs         = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/depth_fs.glsl"));
+            m_composite_fs     = std::unique_ptr<dw::Shader>(dw::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/decal_composite_fs.glsl"));
+
+            {
+                if (!m_uv_space_vs || !m_decal_project_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::Shader* shaders[] = { m_uv_space_vs.get(), m_decal_project_fs.get() };
+                m_decal_program       = std::make_unique<dw::Program>(2, shaders);
+
+                if (!m_decal_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+
+                m_decal_program->uniform_block_binding("GlobalUniforms", 0);
+            }
+
+            {
+                if (!m_uv_space_vs || !m_texture_init_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::Shader* shaders[]  = { m_uv_space_vs.get(), m_texture_init_fs.get() };
+                m_texture_init_program = std::make_unique<dw::Program>(2, shaders);
+
+                if (!m_texture_init_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+
+                m_texture_init_program->uniform_block_binding("GlobalUniforms", 0);
+            }
+
+            {
+                if (!m_depth_vs || !m_depth_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::Shader* shaders[] = { m_depth_vs.get(), m_depth_fs.get() };
+                m_depth_program       = std::make_unique<dw::Program>(2, shaders);
+
+                if (!m_texture_init_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+
+                m_depth_program->uniform_block_binding("GlobalUniforms", 0);
+            }
+
+            {
+                if (!m_mesh_vs || !m_mesh_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::Shader* shaders[] = { m_mesh_vs.get(), m_mesh_fs.get() };
+                m_mesh_program        = std::make_unique<dw::Program>(2, shaders);
+
+                if (!m_mesh_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+
+                m_mesh_program->uniform_block_binding("GlobalUniforms", 0);
+            }
+
+            {
+                if (!m_triangle_vs || !m_visualize_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
+                }
+
+                // Create general shader program
+                dw::Shader* shaders[] = { m_triangle_vs.get(), m_visualize_fs.get() };
+                m_visualize_program   = std::make_unique<dw::Program>(2, shaders);
+
+                if (!m_visualize_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+
+                m_visualize_program->uniform_block_binding("GlobalUniforms", 0);
+            }
+
+            {
+                if (!m_triangle_vs || !m_composite_fs)
+                {
+                    DW_LOG_FATAL("Failed to create Shaders");
+                    return false;
                 }
 
-                // Create general shader program
-                dw::Shader* shaders[]  = { m_uv_space_vs.get(), m_texture_init_fs.get() };
-                m_texture_init_program = std::make_unique<dw::Program>(2, shaders);
+                // Create general shader program
+                dw::Shader* shaders[]     = { m_triangle_vs.get(), m_composite_fs.get() };
+                m_decal_composite_program = std::make_unique<dw::Program>(2, shaders);
+
+                if (!m_decal_composite_program)
+                {
+                    DW_LOG_FATAL("Failed to create Shader Program");
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void create_framebuffers()
+    {
+        m_albedo_mip_levels = int32_t(log2f(float(m_atlas_size))) + 1;
+
+        m_atlas_fbo = std::make_unique<dw::Framebuffer>();
+
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+        {
+            const DecalChannelDesc& channel = DECAL_CHANNELS[i];
+
+            m_atlas_textures[i] = std::make_unique<dw::Texture2D>(m_atlas_size, m_atlas_size, 1, m_albedo_mip_levels, 1, channel.internal_format, channel.format, GL_UNSIGNED_BYTE);
+
+            m_atlas_textures[i]->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+            m_atlas_textures[i]->set_min_filter(GL_LINEAR_MIPMAP_LINEAR);
+            m_atlas_textures[i]->set_mag_filter(GL_LINEAR);
+
+            m_atlas_fbo->attach_render_target(i, m_atlas_textures[i].get(), 0, 0);
+
+            // Decals rendered at a coarser LOD go through these RGBA textures, whose mip 0 matches mip 1 of the atlas.
+            m_scratch_textures[i] = std::make_unique<dw::Texture2D>(m_atlas_size / 2, m_atlas_size / 2, 1, m_albedo_mip_levels - 1, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+
+            m_scratch_textures[i]->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+            m_scratch_textures[i]->set_min_filter(GL_LINEAR_MIPMAP_NEAREST);
+            m_scratch_textures[i]->set_mag_filter(GL_LINEAR);
+        }
+
+        m_atlas_fbo->bind();
+        glDrawBuffers(DECAL_CHANNEL_COUNT, DECAL_CHANNEL_ATTACHMENTS);
+
+        // Attachments of these are switched per mip level while applying decals.
+        if (m_lod_read_fbo == 0)
+            glGenFramebuffers(1, &m_lod_read_fbo);
+
+        if (m_lod_draw_fbo == 0)
+            glGenFramebuffers(1, &m_lod_draw_fbo);
+
+        m_depth_texture = std::make_unique<dw::Texture2D>(DEPTH_TEXTURE_SIZE, DEPTH_TEXTURE_SIZE, 1, 1, 1, GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_HALF_FLOAT);
+
+        m_depth_texture->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+        m_depth_fbo = std::make_unique<dw::Framebuffer>();
+
+        m_depth_fbo->attach_depth_stencil_target(m_depth_texture.get(), 0, 0);
+
+        // Last rendered frame, presented again while nothing changes.
+        m_scene_color = std::make_unique<dw::Texture2D>(m_width, m_height, 1, 1, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        m_scene_depth = std::make_unique<dw::Texture2D>(m_width, m_height, 1, 1, 1, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
+
+        m_scene_fbo = std::make_unique<dw::Framebuffer>();
+
+        m_scene_fbo->attach_render_target(0, m_scene_color.get(), 0, 0);
+        m_scene_fbo->attach_depth_stencil_target(m_scene_depth.get(), 0, 0);
+
+        m_frame_state_valid = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool create_uniform_buffer()
+    {
+        // Create uniform buffer for global data. It holds a ring of slices, one per update, each aligned for
+        // glBindBufferRange.
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+        m_global_ubo_stride = (sizeof(GlobalUniforms) + alignment - 1) / alignment * alignment;
+        m_global_ubo        = std::make_unique<dw::UniformBuffer>(GL_DYNAMIC_DRAW, GLOBAL_UBO_SLICES * m_global_ubo_stride);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void ui()
+    {
+        if (!m_randomize_decals)
+        {
+            ImGui::DragFloat("Decal Rotation", &m_projector_rotation, 1.0f, -180.0f, 180.0f);
+            ImGui::DragFloat("Decal Size", &m_projector_size, 1.0f, 0.1f, 20.0f);
+
+            const char* listbox_items[] = { "OpenGL", "Vulkan", "DirectX", "Metal" };
+            ImGui::ListBox("Selected Decal", &m_selected_decal, listbox_items, IM_ARRAYSIZE(listbox_items), 4);
+        }
+
+        ImGui::Checkbox("Randomize Decals", &m_randomize_decals);
+        ImGui::Checkbox("Visualize Projector Frustum", &m_visualize_projection_frustum);
+        ImGui::Checkbox("Visualize Hit Point", &m_visualize_hit_point);
+        ImGui::Checkbox("Visualize Decal Atlas", &m_visualize_albedo_map);
+
+        if (m_visualize_albedo_map)
+        {
+            const char* channel_items[] = { DECAL_CHANNELS[0].name, DECAL_CHANNELS[1].name, DECAL_CHANNELS[2].name };
+            ImGui::Combo("Visualized Channel", &m_visualized_channel, channel_items, IM_ARRAYSIZE(channel_items));
+        }
+        ImGui::Checkbox("Conservative Rasterization", &m_enable_conservative_raster);
+        ImGui::Checkbox("Render On Demand", &m_render_on_demand);
+
+        if (m_render_on_demand)
+            ImGui::Checkbox("Idle Until Input", &m_idle_mode);
+
+        if (m_mesh)
+            ImGui::Checkbox("Slim Vertex Stream", &m_use_slim_vertex_stream);
+
+        ImGui::Checkbox("Decal LOD", &m_enable_decal_lod);
+
+        if (m_enable_decal_lod)
+            ImGui::SliderFloat("Decal LOD Bias", &m_decal_lod_bias, -4.0f, 2.0f);
+
+        if (ImGui::Button("Clear Texture"))
+            init_texture();
+
+        if (!GLAD_GL_NV_conservative_raster && !GLAD_GL_INTEL_conservative_rasterization)
+        {
+            ImGui::Separator();
+            ImGui::Text("Note: Conservative Rasterization not supported on this GPU.");
+        }
+
+        ImGui::Separator();
+        ImGui::Text("Frames         : %llu rendered, %llu presented, %llu idle waits", (unsigned long long)m_frames_rendered, (unsigned long long)m_frames_presented, (unsigned long long)m_idle_waits);
+
+        ImGui::Separator();
+        ImGui::DragFloat("Target Texel Density", &m_target_texel_density, 0.5f, 1.0f, 256.0f);
+
+        if (ImGui::Button("Resize Atlas (Clears Texture)"))
+            resize_atlas();
+
+        ImGui::Text("Atlas Size     : %ux%u", m_atlas_size, m_atlas_size);
+        ImGui::Text("Atlas Memory   : %.1f MB (%.1f MB at %ux%u)", double(atlas_memory_bytes(m_atlas_size)) / (1024.0 * 1024.0), double(atlas_memory_bytes(MAX_ATLAS_SIZE)) / (1024.0 * 1024.0), uint32_t(MAX_ATLAS_SIZE), uint32_t(MAX_ATLAS_SIZE));
+        ImGui::Text("Texel Density  : %.2f texels/unit", m_texel_density);
+        ImGui::Text("Last Decal LOD : %d", m_last_decal_lod);
+        ImGui::Text("Stale Decals   : %u (%llu refined)", stale_lod_decal_count(), (unsigned long long)m_lod_refinements);
+        ImGui::Text("Texels/Decal   : %.0f", m_decals_applied > 0 ? double(m_decal_texels_written) / double(m_decals_applied) : 0.0);
+
+        if (ImGui::Button("Benchmark Distant Impacts (Clears Texture)"))
+            ImGui::OpenPopup("Benchmark Distant Impacts");
+
+        // The benchmark paints over the atlas, so it has to be cleared before and after, and that cannot be undone.
+        if (ImGui::BeginPopupModal("Benchmark Distant Impacts", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+        {
+            ImGui::Text("This clears the decal atlas and the undo history.");
+
+            if (ImGui::Button("Run"))
+            {
+                benchmark_distant_impacts();
+                ImGui::CloseCurrentPopup();
+            }
+
+            ImGui::SameLine();
+
+            if (ImGui::Button("Cancel"))
+                ImGui::CloseCurrentPopup();
+
+            ImGui::EndPopup();
+        }
+
+        if (m_distant_impact_benchmarked)
+        {
+            ImGui::Text("LOD   : %.0f texels/decal, %.3f ms", m_distant_impact_texels[0], m_distant_impact_ms[0]);
+            ImGui::Text("Mip 0 : %.0f texels/decal, %.3f ms", m_distant_impact_texels[1], m_distant_impact_ms[1]);
+        }
+
+        if (m_submission_service.is_running())
+        {
+            DecalSubmissionStats stats;
+            m_submission_service.stats(stats);
+
+            ImGui::Separator();
+            ImGui::Text("Submission Service");
+            ImGui::Text("Received       : %llu (ring), %llu (socket)", (unsigned long long)stats.received_ring, (unsigned long long)stats.received_socket);
+            ImGui::Text("Queued/Applied : %llu / %llu", (unsigned long long)stats.queued, (unsigned long long)stats.applied);
+            ImGui::Text("Drops/Rejected : %llu / %llu", (unsigned long long)stats.producer_drops, (unsigned long long)stats.rejected);
+            ImGui::Text("Latency        : %.3f ms avg, %.3f ms max", stats.avg_latency_ms, stats.max_latency_ms);
+        }
+
+        ImGui::Separator();
+        ImGui::Text("Undo History");
+
+        if (ImGui::Button("Undo (Ctrl+Z)"))
+            undo();
+
+        ImGui::SameLine();
+
+        if (ImGui::Button("Redo (Ctrl+Y)"))
+            redo();
+
+        ImGui::Text("Steps          : %u undo, %u redo", uint32_t(m_undo_stack.step_count()), uint32_t(m_redo_stack.step_count()));
+        ImGui::Text("Arena          : %.2f / %.2f MB", double(m_undo_stack.used() + m_redo_stack.used()) / (1024.0 * 1024.0), double(m_undo_stack.capacity() + m_redo_stack.capacity()) / (1024.0 * 1024.0));
+        ImGui::Text("Last Step      : %u tiles, %.1f KB (%.1f KB raw)", m_last_step_tiles, double(m_last_step_bytes) / 1024.0, double(m_last_step_raw_bytes) / 1024.0);
+        ImGui::Text("Avg Step       : %.1f KB", m_undo_stack.step_count() > 0 ? double(m_undo_stack.used()) / double(m_undo_stack.step_count()) / 1024.0 : 0.0);
+        ImGui::Text("Undo Latency   : %.3f ms", m_last_undo_ms);
+
+        ImGui::Separator();
+
+        if (ImGui::TreeNode("Task Scheduler"))
+        {
+            m_scheduler.stats(m_scheduler_stats);
+
+            ImGui::Text("Threads        : %u%s", m_scheduler.thread_count(), m_pin_threads ? " (pinned)" : "");
+
+            for (uint32_t i = 0; i < m_scheduler_stats.size(); i++)
+            {
+                const TaskWorkerStats& stats = m_scheduler_stats[i];
+                ImGui::Text("Thread %-3u     : %5.1f%%, %llu tasks, %llu steals", i, stats.utilization * 100.0f, (unsigned long long)stats.tasks, (unsigned long long)stats.steals);
+            }
+
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Transient Memory"))
+        {
+            ImGui::Text("Frame Arena    : %.1f / %.1f KB peak, grown %u times", double(m_frame_arena.peak()) / 1024.0, double(m_frame_arena.capacity()) / 1024.0, uint32_t(m_frame_arena.grow_count()));
+            ImGui::Text("Allocations    : %llu last decal, %llu after the first %d decals", (unsigned long long)m_last_decal_allocations, (unsigned long long)m_warm_decal_allocations, DECAL_ALLOCATION_WARM_UP);
+
+            ImGui::TreePop();
+        }
+
+        if (is_streaming_mesh() && ImGui::TreeNode("Mesh Streaming"))
+        {
+            const MeshChunkHeader& header = m_chunk_file.header();
+
+            ImGui::Text("Chunks         : %u / %u resident, %u loading", m_resident_chunks, header.chunk_count, m_chunk_loads_in_flight);
+            ImGui::Text("Triangles      : %llu", (unsigned long long)header.triangle_count);
+            ImGui::Text("Memory         : %.1f / %d MB", double(m_chunk_memory_bytes) / (1024.0 * 1024.0), m_chunk_memory_mb);
+            ImGui::Text("Loads          : %llu, %llu evictions", (unsigned long long)m_chunk_loads, (unsigned long long)m_chunk_evictions);
+            ImGui::Text("Peak RSS       : %.1f MB", double(peak_rss_bytes()) / (1024.0 * 1024.0));
+            ImGui::SliderInt("Memory Cap (MB)", &m_chunk_memory_mb, 64, CHUNK_MAX_MEMORY_MB);
+
+            ImGui::TreePop();
+        }
+
+        if (!m_mesh)
+            return;
+
+        ImGui::Separator();
+
+        if (ImGui::Button("Benchmark Vertex Streams"))
+            benchmark_vertex_streams();
+
+        if (m_vertex_stream_benchmarked)
+        {
+            ImGui::Text("Full Stream (%u bytes/vertex)", uint32_t(sizeof(dw::Vertex)));
+            ImGui::Text("  Original  : %.3f ms measured, %.2f MB modeled", m_stream_ms[0][0], m_stream_fetch_mb[0][0]);
+            ImGui::Text("  Reordered : %.3f ms measured, %.2f MB modeled", m_stream_ms[0][1], m_stream_fetch_mb[0][1]);
+            ImGui::Text("Slim Stream (%u bytes/vertex)", uint32_t(sizeof(SlimVertex)));
+            ImGui::Text("  Original  : %.3f ms measured, %.2f MB modeled", m_stream_ms[1][0], m_stream_fetch_mb[1][0]);
+            ImGui::Text("  Reordered : %.3f ms measured, %.2f MB modeled", m_stream_ms[1][1], m_stream_fetch_mb[1][1]);
+            ImGui::Text("ACMR        : %.3f -> %.3f (modeled)", m_original_acmr, m_optimized_acmr);
+            ImGui::TextDisabled("Fetched MB are a model estimate (ACMR x stride), not a measurement.");
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool load_scene()
+    {
+        const std::string& path = g_launch_options.mesh_path;
+
+        // Baked chunk files are streamed, anything else is loaded into memory in one piece.
+        if (path.size() > 7 && path.compare(path.size() - 7, 7, ".chunks") == 0)
+        {
+            if (!open_streamed_mesh(path))
+            {
+                DW_LOG_FATAL("Failed to open chunk file: " + path);
+                return false;
+            }
+        }
+        else
+        {
+            m_mesh = dw::Mesh::load(path);
+
+            if (!m_mesh)
+            {
+                DW_LOG_FATAL("Failed to load mesh!");
+                return false;
+            }
+        }
+
+        compute_texel_density();
+        select_atlas_size();
 
-                if (!m_texture_init_program)
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void compute_texel_density()
+    {
+        // The areas of a streamed mesh were summed up when it was baked.
+        if (is_streaming_mesh())
+        {
+            const MeshChunkHeader& header = m_chunk_file.header();
+
+            m_uv_density = header.world_area > 0.0 ? float(sqrt(header.uv_area / header.world_area)) : 0.0f;
+            return;
+        }
+
+        dw::Vertex*  vertices   = m_mesh->vertices();
+        uint32_t*    indices    = m_mesh->indices();
+        dw::SubMesh* submeshes  = m_mesh->sub_meshes();
+        double       world_area = 0.0;
+        double       uv_area    = 0.0;
+
+        for (uint32_t i = 0; i < m_mesh->sub_mesh_count(); i++)
+        {
+            dw::SubMesh& submesh = submeshes[i];
+
+            for (uint32_t j = submesh.base_index; j < submesh.base_index + submesh.index_count; j += 3)
+            {
+                dw::Vertex& v0 = vertices[submesh.base_vertex + indices[j]];
+                dw::Vertex& v1 = vertices[submesh.base_vertex + indices[j + 1]];
+                dw::Vertex& v2 = vertices[submesh.base_vertex + indices[j + 2]];
+
+                glm::vec2 uv_e0 = v1.tex_coord - v0.tex_coord;
+                glm::vec2 uv_e1 = v2.tex_coord - v0.tex_coord;
+
+                world_area += 0.5 * glm::length(glm::cross(v1.position - v0.position, v2.position - v0.position));
+                uv_area += 0.5 * fabs(uv_e0.x * uv_e1.y - uv_e0.y * uv_e1.x);
+            }
+        }
+
+        // Average UV distance per world unit along one axis. Multiplied by the atlas size this gives the texel density.
+        m_uv_density = world_area > 0.0 ? float(sqrt(uv_area / world_area)) : 0.0f;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void select_atlas_size()
+    {
+        uint32_t size = MIN_ATLAS_SIZE;
+
+        // Smallest power of two that reaches the target density, falling back to the largest atlas if the UVs are degenerate.
+        if (m_uv_density > 0.0f)
+        {
+            while (size < MAX_ATLAS_SIZE && float(size) * m_uv_density < m_target_texel_density)
+                size *= 2;
+        }
+        else
+            size = MAX_ATLAS_SIZE;
+
+        m_atlas_size    = size;
+        m_texel_density = m_uv_density * float(size);
+
+        DW_LOG_INFO("Decal Atlas: " + std::to_string(m_atlas_size) + "x" + std::to_string(m_atlas_size) + " at " + std::to_string(m_texel_density) + " texels/unit, " + std::to_string(atlas_memory_bytes(m_atlas_size) / (1024 * 1024)) + " MB (" + std::to_string(atlas_memory_bytes(MAX_ATLAS_SIZE) / (1024 * 1024)) + " MB at " + std::to_string(MAX_ATLAS_SIZE) + "x" + std::to_string(MAX_ATLAS_SIZE) + ")");
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    uint64_t atlas_memory_bytes(uint32_t size)
+    {
+        uint64_t bytes = 0;
+
+        // Full mip chain of every channel, plus the RGBA scratch textures that start at mip 1.
+        for (uint32_t level = 0; (size >> level) > 0; level++)
+        {
+            uint64_t texels = uint64_t(size >> level) * uint64_t(size >> level);
+
+            for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+                bytes += texels * (DECAL_CHANNELS[i].pixel_size + (level > 0 ? 4 : 0));
+        }
+
+        return bytes;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void resize_atlas()
+    {
+        select_atlas_size();
+        create_framebuffers();
+        init_history();
+        init_texture();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool create_slim_vertex_stream()
+    {
+        dw::Vertex* vertex_ptr = m_mesh->vertices();
+
+        std::vector<SlimVertex> vertices(m_mesh->vertex_count());
+        uint32_t                clamped = 0;
+
+        for (uint32_t i = 0; i < m_mesh->vertex_count(); i++)
+        {
+            // The UV-space passes use UVs as clip space positions, so anything outside [0, 1] falls off the atlas with
+            // either stream. Clamping only makes it fit unorm16.
+            glm::vec2 uv = glm::clamp(vertex_ptr[i].tex_coord, glm::vec2(0.0f), glm::vec2(1.0f));
+
+            if (uv != vertex_ptr[i].tex_coord)
+                clamped++;
+
+            vertices[i].position     = vertex_ptr[i].position;
+            vertices[i].tex_coord[0] = uint16_t(uv.x * 65535.0f + 0.5f);
+            vertices[i].tex_coord[1] = uint16_t(uv.y * 65535.0f + 0.5f);
+            vertices[i].normal       = pack_snorm_10_10_10(glm::normalize(vertex_ptr[i].normal));
+        }
+
+        if (clamped > 0)
+            DW_LOG_WARNING(std::to_string(clamped) + " vertices have UVs outside [0, 1], decals will not reach those parts of the mesh");
+
+        std::vector<uint32_t> indices(m_mesh->indices(), m_mesh->indices() + m_mesh->index_count());
+        dw::SubMesh*          submeshes = m_mesh->sub_meshes();
+        uint32_t              triangles = 0;
+        float                 original  = 0.0f;
+        float                 optimized = 0.0f;
+
+        // Reorder the triangles of each submesh in place so that the existing base index/vertex offsets stay valid.
+        for (uint32_t i = 0; i < m_mesh->sub_mesh_count(); i++)
+        {
+            dw::SubMesh& submesh      = submeshes[i];
+            uint32_t*    first        = &indices[submesh.base_index];
+            uint32_t     vertex_count = *std::max_element(first, first + submesh.index_count) + 1;
+
+            original += average_cache_miss_ratio(first, submesh.index_count, vertex_count) * (submesh.index_count / 3);
+            optimize_vertex_cache(first, submesh.index_count, vertex_count);
+            optimized += average_cache_miss_ratio(first, submesh.index_count, vertex_count) * (submesh.index_count / 3);
+            triangles += submesh.index_count / 3;
+        }
+
+        m_original_acmr  = original / float(triangles);
+        m_optimized_acmr = optimized / float(triangles);
+
+        m_slim_vbo = std::make_unique<dw::VertexBuffer>(GL_STATIC_DRAW, sizeof(SlimVertex) * vertices.size(), vertices.data());
+        m_slim_ibo = std::make_unique<dw::IndexBuffer>(GL_STATIC_DRAW, sizeof(uint32_t) * indices.size(), indices.data());
+        m_slim_vao = create_slim_vertex_array(m_slim_ibo.get());
+
+        if (!m_slim_vao)
+        {
+            DW_LOG_FATAL("Failed to create slim Vertex Array");
+            return false;
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    std::unique_ptr<dw::VertexArray> create_slim_vertex_array(dw::IndexBuffer* ibo)
+    {
+        dw::VertexAttrib attribs[] = {
+            { 3, GL_FLOAT, false, 0 },
+            { 2, GL_UNSIGNED_SHORT, true, offsetof(SlimVertex, tex_coord) },
+            { 4, GL_INT_2_10_10_10_REV, true, offsetof(SlimVertex, normal) }
+        };
+
+        return std::make_unique<dw::VertexArray>(m_slim_vbo.get(), ibo, sizeof(SlimVertex), 3, attribs);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    dw::VertexArray* uv_pass_vertex_array()
+    {
+        return m_use_slim_vertex_stream ? m_slim_vao.get() : mesh_vertex_array();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Streamed meshes have a vertex array per chunk instead.
+    dw::VertexArray* mesh_vertex_array()
+    {
+        return m_mesh ? m_mesh->mesh_vertex_array() : nullptr;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    double time_vertex_stream(dw::VertexArray* vao)
+    {
+        GLuint query;
+        glGenQueries(1, &query);
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+
+        for (uint32_t i = 0; i < VERTEX_STREAM_BENCHMARK_ITERATIONS; i++)
+        {
+            // Depth pass.
+            render_scene(m_depth_fbo.get(), m_depth_program, vao, m_global_uniforms.light_view_proj, 0, 0, DEPTH_TEXTURE_SIZE, DEPTH_TEXTURE_SIZE, GL_BACK);
+
+            // Decal pass with color writes masked off so that the atlas is left untouched.
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_CULL_FACE);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+            m_atlas_fbo->bind();
+            glViewport(0, 0, m_atlas_size, m_atlas_size);
+
+            m_decal_program->use();
+            bind_global_uniforms();
+
+            if (m_decal_program->set_uniform("s_Depth", DECAL_CHANNEL_COUNT))
+                m_depth_texture->bind(DECAL_CHANNEL_COUNT);
+
+            render_mesh(vao, m_transform, m_global_uniforms.light_view_proj, m_decal_program);
+
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        }
+
+        glEndQuery(GL_TIME_ELAPSED);
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        glDeleteQueries(1, &query);
+
+        return double(elapsed) / (1000000.0 * VERTEX_STREAM_BENCHMARK_ITERATIONS);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Times every combination of vertex layout and triangle order, so that the gain of the slimmer layout is not mixed
+    // up with the gain of the reordering. Only the reordered slim stream is kept, the other two are built just for this.
+    void benchmark_vertex_streams()
+    {
+        // The full stream keeps the dw::Vertex stride but only binds what the passes read.
+        dw::VertexAttrib full_attribs[] = {
+            { 3, GL_FLOAT, false, offsetof(dw::Vertex, position) },
+            { 2, GL_FLOAT, false, offsetof(dw::Vertex, tex_coord) },
+            { 3, GL_FLOAT, false, offsetof(dw::Vertex, normal) }
+        };
+
+        std::unique_ptr<dw::VertexBuffer> full_vbo     = std::make_unique<dw::VertexBuffer>(GL_STATIC_DRAW, sizeof(dw::Vertex) * m_mesh->vertex_count(), m_mesh->vertices());
+        std::unique_ptr<dw::IndexBuffer>  original_ibo = std::make_unique<dw::IndexBuffer>(GL_STATIC_DRAW, sizeof(uint32_t) * m_mesh->index_count(), m_mesh->indices());
+        std::unique_ptr<dw::VertexArray>  full_vao     = std::make_unique<dw::VertexArray>(full_vbo.get(), m_slim_ibo.get(), sizeof(dw::Vertex), 3, full_attribs);
+        std::unique_ptr<dw::VertexArray>  slim_vao     = create_slim_vertex_array(original_ibo.get());
+
+        dw::VertexArray* vaos[2][2]      = { { m_mesh->mesh_vertex_array(), full_vao.get() }, { slim_vao.get(), m_slim_vao.get() } };
+        const double     vertex_sizes[2] = { double(sizeof(dw::Vertex)), double(sizeof(SlimVertex)) };
+        const double     acmrs[2]        = { m_original_acmr, m_optimized_acmr };
+        const char*      stream_names[2] = { "Full", "Slim" };
+        const char*      order_names[2]  = { "original", "reordered" };
+        const double     triangles       = double(m_mesh->index_count() / 3);
+        const double     mb              = 1024.0 * 1024.0;
+
+        for (uint32_t stream = 0; stream < 2; stream++)
+        {
+            for (uint32_t order = 0; order < 2; order++)
+            {
+                // Not measured: both passes are assumed to fetch a whole vertex per cache miss, with the miss rate taken
+                // from the ACMR of the FIFO cache model.
+                m_stream_ms[stream][order]       = float(time_vertex_stream(vaos[stream][order]));
+                m_stream_fetch_mb[stream][order] = float(2.0 * triangles * acmrs[order] * vertex_sizes[stream] / mb);
+
+                DW_LOG_INFO("Vertex Stream Benchmark: " + std::string(stream_names[stream]) + " (" + order_names[order] + ") = " + std::to_string(m_stream_ms[stream][order]) + " ms measured, " + std::to_string(m_stream_fetch_mb[stream][order]) + " MB fetched (modeled estimate: ACMR x stride, not measured)");
+            }
+        }
+
+        m_vertex_stream_benchmarked = true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool load_decals()
+    {
+        const char* names[] = { "opengl", "vulkan", "directx", "metal" };
+
+        m_decal_assets.resize(IM_ARRAYSIZE(names));
+
+        for (uint32_t i = 0; i < m_decal_assets.size(); i++)
+        {
+            DecalAsset& asset = m_decal_assets[i];
+
+            for (uint32_t j = 0; j < DECAL_CHANNEL_COUNT; j++)
+            {
+                std::string path = std::string("texture/") + names[i] + DECAL_CHANNELS[j].file_suffix + ".png";
+
+                // Only albedo is mandatory, the other layers are generated from it when they're not shipped.
+                if (j != DECAL_CHANNEL_ALBEDO && !std::ifstream(path).good())
+                    continue;
+
+                asset.layers[j] = std::unique_ptr<dw::Texture2D>(dw::Texture2D::create_from_files(path, j == DECAL_CHANNEL_ALBEDO));
+
+                if (!asset.layers[j])
                 {
-                    DW_LOG_FATAL("Failed to create Shader Program");
+                    DW_LOG_FATAL("Failed to load decal texture: " + path);
                     return false;
                 }
+            }
+
+            if (!asset.layers[DECAL_CHANNEL_NORMAL] || !asset.layers[DECAL_CHANNEL_ROUGHNESS])
+                generate_decal_layers(asset);
+
+            for (uint32_t j = 0; j < DECAL_CHANNEL_COUNT; j++)
+            {
+                asset.layers[j]->set_min_filter(GL_LINEAR_MIPMAP_LINEAR);
+                asset.layers[j]->set_mag_filter(GL_LINEAR);
+            }
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void generate_decal_layers(DecalAsset& asset)
+    {
+        dw::Texture2D* albedo = asset.layers[DECAL_CHANNEL_ALBEDO].get();
+        int32_t        w      = albedo->width();
+        int32_t        h      = albedo->height();
+
+        std::vector<uint8_t> pixels(w * h * 4);
+
+        albedo->bind(0);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        std::vector<uint8_t> normals(w * h * 4);
+        std::vector<uint8_t> roughness(w * h * 4);
+
+        // Treat the alpha mask as a height field so that the decal appears embossed, and make it glossier than the
+        // surface it is applied to.
+        m_scheduler.parallel_for(uint32_t(h), DECAL_LAYER_GRAIN_ROWS, [&](uint32_t begin, uint32_t end) {
+            for (int32_t y = int32_t(begin); y < int32_t(end); y++)
+            {
+                for (int32_t x = 0; x < w; x++)
+                {
+                    auto height = [&](int32_t sx, int32_t sy) {
+                        sx = glm::clamp(sx, 0, w - 1);
+                        sy = glm::clamp(sy, 0, h - 1);
+                        return float(pixels[(sy * w + sx) * 4 + 3]) / 255.0f;
+                    };
+
+                    float dx = height(x + 1, y) - height(x - 1, y);
+                    float dy = height(x, y + 1) - height(x, y - 1);
+
+                    glm::vec3 n   = glm::normalize(glm::vec3(-dx * DECAL_NORMAL_STRENGTH, -dy * DECAL_NORMAL_STRENGTH, 1.0f)) * 0.5f + 0.5f;
+                    uint32_t  idx = (y * w + x) * 4;
+
+                    normals[idx]     = uint8_t(n.x * 255.0f);
+                    normals[idx + 1] = uint8_t(n.y * 255.0f);
+                    normals[idx + 2] = uint8_t(n.z * 255.0f);
+                    normals[idx + 3] = pixels[idx + 3];
+
+                    roughness[idx]     = uint8_t(DECAL_DEFAULT_ROUGHNESS * 255.0f);
+                    roughness[idx + 1] = 0;
+                    roughness[idx + 2] = 0;
+                    roughness[idx + 3] = pixels[idx + 3];
+                }
+            }
+        });
+
+        int32_t mip_levels = int32_t(log2f(float(std::max(w, h)))) + 1;
+
+        if (!asset.layers[DECAL_CHANNEL_NORMAL])
+        {
+            asset.layers[DECAL_CHANNEL_NORMAL] = std::make_unique<dw::Texture2D>(w, h, 1, mip_levels, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+            asset.layers[DECAL_CHANNEL_NORMAL]->set_data(0, 0, normals.data());
+            asset.layers[DECAL_CHANNEL_NORMAL]->generate_mipmaps();
+        }
+
+        if (!asset.layers[DECAL_CHANNEL_ROUGHNESS])
+        {
+            asset.layers[DECAL_CHANNEL_ROUGHNESS] = std::make_unique<dw::Texture2D>(w, h, 1, mip_levels, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+            asset.layers[DECAL_CHANNEL_ROUGHNESS]->set_data(0, 0, roughness.data());
+            asset.layers[DECAL_CHANNEL_ROUGHNESS]->generate_mipmaps();
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool initialize_embree()
+    {
+        // Keep Embree from starting a thread pool of its own. With as many user threads as build threads, Embree spawns
+        // no workers and scene builds run on the scheduler threads that join the commit. This relies on Embree's
+        // internal tasking system, which the top-level CMakeLists.txt selects.
+        const std::string threads = std::to_string(m_scheduler.thread_count());
+        const std::string config  = "threads=" + threads + ",user_threads=" + threads;
+
+        m_embree_device = rtcNewDevice(config.c_str());
+
+        RTCError embree_error = rtcGetDeviceError(m_embree_device);
+
+        if (embree_error == RTC_ERROR_UNSUPPORTED_CPU)
+            throw std::runtime_error("Your CPU does not meet the minimum requirements for embree");
+        else if (embree_error != RTC_ERROR_NONE)
+            throw std::runtime_error("Failed to initialize embree!");
+
+        m_embree_scene = rtcNewScene(m_embree_device);
+
+        // The chunks of a streamed mesh each get a BVH of their own, which are instanced into this scene as they are
+        // streamed in. Its own BVH only covers the instances and is rebuilt whenever they change.
+        if (is_streaming_mesh())
+        {
+            rtcSetSceneFlags(m_embree_scene, RTC_SCENE_FLAG_DYNAMIC);
+            rtcSetSceneBuildQuality(m_embree_scene, RTC_BUILD_QUALITY_LOW);
+
+            commit_embree_scene(m_embree_scene);
+
+            return true;
+        }
+
+        m_embree_triangle_mesh = rtcNewGeometry(m_embree_device, RTC_GEOMETRY_TYPE_TRIANGLE);
+
+        std::vector<glm::vec3> vertices(m_mesh->vertex_count());
+        std::vector<uint32_t>  indices(m_mesh->index_count());
+        uint32_t               idx        = 0;
+        dw::Vertex*            vertex_ptr = m_mesh->vertices();
+        uint32_t*              index_ptr  = m_mesh->indices();
+
+        for (int i = 0; i < m_mesh->vertex_count(); i++)
+            vertices[i] = vertex_ptr[i].position;
+
+        for (int i = 0; i < m_mesh->sub_mesh_count(); i++)
+        {
+            dw::SubMesh& submesh = m_mesh->sub_meshes()[i];
+
+            for (int j = submesh.base_index; j < (submesh.base_index + submesh.index_count); j++)
+                indices[idx++] = submesh.base_vertex + index_ptr[j];
+        }
+
+        void* data = rtcSetNewGeometryBuffer(m_embree_triangle_mesh, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, sizeof(glm::vec3), m_mesh->vertex_count());
+        memcpy(data, vertices.data(), vertices.size() * sizeof(glm::vec3));
+
+        data = rtcSetNewGeometryBuffer(m_embree_triangle_mesh, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, 3 * sizeof(uint32_t), m_mesh->index_count() / 3);
+        memcpy(data, indices.data(), indices.size() * sizeof(uint32_t));
+
+        rtcCommitGeometry(m_embree_triangle_mesh);
+        rtcAttachGeometry(m_embree_scene, m_embree_triangle_mesh);
+
+        commit_embree_scene(m_embree_scene);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void commit_embree_scene(RTCScene scene)
+    {
+        TaskGroup group;
+
+        // The first thread to join starts the build, the others help until it is done.
+        for (uint32_t i = 0; i < std::max(m_scheduler.thread_count(), 1u); i++)
+            m_scheduler.run(group, [scene]() { rtcJoinCommitScene(scene); });
+
+        m_scheduler.wait(group);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    inline bool is_streaming_mesh() const { return m_chunk_file.is_open(); }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Most vertices a decal projects at once: the whole mesh, or one chunk of a streamed mesh.
+    uint32_t largest_vertex_count()
+    {
+        uint32_t count = m_mesh ? m_mesh->vertex_count() : 0;
+
+        if (is_streaming_mesh())
+        {
+            for (const MeshChunkDesc& desc : m_chunk_file.chunks())
+                count = std::max(count, desc.vertex_count);
+        }
+
+        return count;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool open_streamed_mesh(const std::string& path)
+    {
+        if (!m_chunk_file.open(path))
+            return false;
+
+        const MeshChunkHeader& header = m_chunk_file.header();
+
+        m_chunks = std::unique_ptr<StreamedChunk[]>(new StreamedChunk[header.chunk_count]);
+
+        m_chunk_order.resize(header.chunk_count);
+        m_chunk_priority.resize(header.chunk_count);
+        m_chunk_required.resize(header.chunk_count);
+
+        for (uint32_t i = 0; i < header.chunk_count; i++)
+            m_chunk_order[i] = i;
+
+        // The slim stream is built from the in-memory mesh.
+        m_use_slim_vertex_stream = false;
+
+        DW_LOG_INFO("Streaming " + path + ": " + std::to_string(header.triangle_count) + " triangles in " + std::to_string(header.chunk_count) + " chunks, " + std::to_string(m_chunk_memory_mb) + " MB memory cap");
+
+        return true;
+    }
 
-                m_texture_init_program->uniform_block_binding("GlobalUniforms", 0);
-            }
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-            {
-                if (!m_depth_vs || !m_depth_fs)
-                {
-                    DW_LOG_FATAL("Failed to create Shaders");
-                    return false;
-                }
+    void close_streamed_mesh()
+    {
+        for (uint32_t i = 0; i < m_chunk_file.header().chunk_count; i++)
+        {
+            if (m_chunks[i].state == CHUNK_LOADING)
+                wait_chunk_load(i);
 
-                // Create general shader program
-                dw::Shader* shaders[] = { m_depth_vs.get(), m_depth_fs.get() };
-                m_depth_program       = std::make_unique<dw::Program>(2, shaders);
+            if (m_chunks[i].state == CHUNK_RESIDENT)
+                evict_chunk(i);
+        }
 
-                if (!m_texture_init_program)
-                {
-                    DW_LOG_FATAL("Failed to create Shader Program");
-                    return false;
-                }
+        DW_LOG_INFO("Mesh streaming: " + std::to_string(m_chunk_loads) + " chunk loads, " + std::to_string(m_chunk_evictions) + " evictions, peak RSS " + std::to_string(peak_rss_bytes() / (1024 * 1024)) + " MB");
 
-                m_depth_program->uniform_block_binding("GlobalUniforms", 0);
-            }
+        m_chunk_file.close();
+    }
 
-            {
-                if (!m_mesh_vs || !m_mesh_fs)
-                {
-                    DW_LOG_FATAL("Failed to create Shaders");
-                    return false;
-                }
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-                // Create general shader program
-                dw::Shader* shaders[] = { m_mesh_vs.get(), m_mesh_fs.get() };
-                m_mesh_program        = std::make_unique<dw::Program>(2, shaders);
+    // What a resident chunk costs: its vertices and indices in system memory (which Embree shares), the same again on
+    // the GPU, and an estimate for its BVH.
+    uint64_t chunk_memory_bytes(uint32_t index)
+    {
+        const MeshChunkDesc& desc = m_chunk_file.chunks()[index];
+        uint64_t             data = uint64_t(desc.vertex_count) * sizeof(ChunkVertex) + uint64_t(desc.index_count) * sizeof(uint32_t);
 
-                if (!m_mesh_program)
-                {
-                    DW_LOG_FATAL("Failed to create Shader Program");
-                    return false;
-                }
+        return 2 * data + uint64_t(desc.index_count / 3) * CHUNK_BVH_BYTES_PER_TRIANGLE;
+    }
 
-                m_mesh_program->uniform_block_binding("GlobalUniforms", 0);
-            }
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-            {
-                if (!m_triangle_vs || !m_visualize_fs)
-                {
-                    DW_LOG_FATAL("Failed to create Shaders");
-                    return false;
-                }
+    // Conservative test of the chunk bounds against a clip space transform, which must include the model transform.
+    bool chunk_overlaps(const glm::mat4& clip, const MeshChunkDesc& desc)
+    {
+        glm::vec4 corners[8];
 
-                // Create general shader program
-                dw::Shader* shaders[] = { m_triangle_vs.get(), m_visualize_fs.get() };
-                m_visualize_program   = std::make_unique<dw::Program>(2, shaders);
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            glm::vec3 corner = glm::vec3((i & 1) ? desc.bounds_max[0] : desc.bounds_min[0],
+                                         (i & 2) ? desc.bounds_max[1] : desc.bounds_min[1],
+                                         (i & 4) ? desc.bounds_max[2] : desc.bounds_min[2]);
 
-                if (!m_visualize_program)
-                {
-                    DW_LOG_FATAL("Failed to create Shader Program");
-                    return false;
-                }
+            corners[i] = clip * glm::vec4(corner, 1.0f);
+        }
 
-                m_visualize_program->uniform_block_binding("GlobalUniforms", 0);
+        // Culled only if all corners are outside of the same clip plane.
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            bool below = true;
+            bool above = true;
+
+            for (const glm::vec4& corner : corners)
+            {
+                below = below && corner[axis] < -corner.w;
+                above = above && corner[axis] > corner.w;
             }
+
+            if (below || above)
+                return false;
         }
 
         return true;
@@ -536,181 +3228,401 @@ private:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void create_framebuffers()
+    void create_chunk_vertex_array(const MeshChunkData& data, StreamedChunk& chunk)
     {
-        m_albedo_texture = std::make_unique<dw::Texture2D>(ALBEDO_TEXTURE_SIZE, ALBEDO_TEXTURE_SIZE, 1, 1, 1, GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE);
+        chunk.vbo = std::make_unique<dw::VertexBuffer>(GL_STATIC_DRAW, sizeof(ChunkVertex) * data.vertices.size(), (void*)data.vertices.data());
+        chunk.ibo = std::make_unique<dw::IndexBuffer>(GL_STATIC_DRAW, sizeof(uint32_t) * data.indices.size(), (void*)data.indices.data());
 
-        m_albedo_texture->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-        m_albedo_texture->set_min_filter(GL_LINEAR_MIPMAP_LINEAR);
-        m_albedo_texture->set_mag_filter(GL_LINEAR);
+        // Same attribute locations as the full vertex stream, minus the tangent frame that no pass reads.
+        dw::VertexAttrib attribs[] = {
+            { 3, GL_FLOAT, false, 0 },
+            { 2, GL_FLOAT, false, offsetof(ChunkVertex, tex_coord) },
+            { 3, GL_FLOAT, false, offsetof(ChunkVertex, normal) }
+        };
 
-        m_albedo_fbo = std::make_unique<dw::Framebuffer>();
+        chunk.vao = std::make_unique<dw::VertexArray>(chunk.vbo.get(), chunk.ibo.get(), sizeof(ChunkVertex), 3, attribs);
+    }
 
-        m_albedo_fbo->attach_render_target(0, m_albedo_texture.get(), 0, 0);
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-        m_depth_texture = std::make_unique<dw::Texture2D>(DEPTH_TEXTURE_SIZE, DEPTH_TEXTURE_SIZE, 1, 1, 1, GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_HALF_FLOAT);
+    // Runs on a scheduler thread: reads the chunk and builds its BVH. Everything that needs the GL context is left to
+    // finish_chunk_load().
+    void load_chunk(uint32_t index)
+    {
+        HeapAllocationCountPause pause;
+        StreamedChunk&           chunk = m_chunks[index];
 
-        m_depth_texture->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+        if (!m_chunk_file.read_chunk(index, chunk.data))
+        {
+            chunk.data = MeshChunkData();
+            return;
+        }
 
-        m_depth_fbo = std::make_unique<dw::Framebuffer>();
+        RTCGeometry geometry = rtcNewGeometry(m_embree_device, RTC_GEOMETRY_TYPE_TRIANGLE);
 
-        m_depth_fbo->attach_depth_stencil_target(m_depth_texture.get(), 0, 0);
+        // Embree reads the positions straight out of the chunk vertices rather than keeping a copy of its own.
+        rtcSetSharedGeometryBuffer(geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, chunk.data.vertices.data(), 0, sizeof(ChunkVertex), chunk.data.vertices.size());
+        rtcSetSharedGeometryBuffer(geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, chunk.data.indices.data(), 0, 3 * sizeof(uint32_t), chunk.data.indices.size() / 3);
+        rtcCommitGeometry(geometry);
+
+        chunk.scene = rtcNewScene(m_embree_device);
+
+        rtcAttachGeometry(chunk.scene, geometry);
+        rtcReleaseGeometry(geometry);
+        rtcCommitScene(chunk.scene);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    bool create_uniform_buffer()
+    void begin_chunk_load(uint32_t index)
     {
-        // Create uniform buffer for global data
-        m_global_ubo = std::make_unique<dw::UniformBuffer>(GL_DYNAMIC_DRAW, sizeof(GlobalUniforms));
+        StreamedChunk& chunk = m_chunks[index];
 
-        return true;
+        chunk.state = CHUNK_LOADING;
+
+        // The memory is accounted for up front so that loads in flight cannot overshoot the cap.
+        m_chunk_memory_bytes += chunk_memory_bytes(index);
+        m_chunk_loads_in_flight++;
+
+        m_scheduler.run(chunk.load, [this, index]() { load_chunk(index); });
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void ui()
+    void wait_chunk_load(uint32_t index)
     {
-        if (!m_randomize_decals)
+        StreamedChunk& chunk = m_chunks[index];
+
+        m_scheduler.wait(chunk.load);
+        m_chunk_loads_in_flight--;
+
+        if (!chunk.scene)
         {
-            ImGui::DragFloat("Decal Rotation", &m_projector_rotation, 1.0f, -180.0f, 180.0f);
-            ImGui::DragFloat("Decal Size", &m_projector_size, 1.0f, 0.1f, 20.0f);
+            DW_LOG_WARNING("Failed to load mesh chunk " + std::to_string(index));
 
-            const char* listbox_items[] = { "OpenGL", "Vulkan", "DirectX", "Metal" };
-            ImGui::ListBox("Selected Decal", &m_selected_decal, listbox_items, IM_ARRAYSIZE(listbox_items), 4);
+            chunk.state  = CHUNK_UNLOADED;
+            chunk.failed = true;
+
+            m_chunk_memory_bytes -= chunk_memory_bytes(index);
+            return;
         }
 
-        ImGui::Checkbox("Randomize Decals", &m_randomize_decals);
-        ImGui::Checkbox("Visualize Projector Frustum", &m_visualize_projection_frustum);
-        ImGui::Checkbox("Visualize Hit Point", &m_visualize_hit_point);
-        ImGui::Checkbox("Visualize Albedo Map", &m_visualize_albedo_map);
-        ImGui::Checkbox("Conservative Rasterization", &m_enable_conservative_raster);
+        create_chunk_vertex_array(chunk.data, chunk);
 
-        if (ImGui::Button("Clear Texture"))
-            init_texture();
+        glm::mat4   identity = glm::mat4(1.0f);
+        RTCGeometry instance = rtcNewGeometry(m_embree_device, RTC_GEOMETRY_TYPE_INSTANCE);
 
-        if (!GLAD_GL_NV_conservative_raster && !GLAD_GL_INTEL_conservative_rasterization)
-        {
-            ImGui::Separator();
-            ImGui::Text("Note: Conservative Rasterization not supported on this GPU.");
-        }
+        rtcSetGeometryInstancedScene(instance, chunk.scene);
+        rtcSetGeometryTransform(instance, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR, &identity[0][0]);
+        rtcCommitGeometry(instance);
+
+        // Instance IDs are chunk indices, so a chunk can be detached again without looking anything up.
+        rtcAttachGeometryByID(m_embree_scene, instance, index);
+        rtcReleaseGeometry(instance);
+
+        chunk.state = CHUNK_RESIDENT;
+
+        m_embree_scene_dirty = true;
+        m_resident_chunks++;
+        m_chunk_loads++;
+        m_geometry_version++;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    bool load_scene()
+    void evict_chunk(uint32_t index)
     {
-        m_mesh = dw::Mesh::load("mesh/teapot_smooth.obj");
+        StreamedChunk& chunk = m_chunks[index];
 
-        if (!m_mesh)
+        rtcDetachGeometry(m_embree_scene, index);
+        rtcReleaseScene(chunk.scene);
+
+        chunk.scene = nullptr;
+        chunk.data  = MeshChunkData();
+        chunk.state = CHUNK_UNLOADED;
+
+        chunk.vao.reset();
+        chunk.ibo.reset();
+        chunk.vbo.reset();
+
+        m_chunk_memory_bytes -= chunk_memory_bytes(index);
+        m_embree_scene_dirty = true;
+        m_resident_chunks--;
+        m_chunk_evictions++;
+        m_geometry_version++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Evicts resident chunks, least wanted first, until the given amount fits under the cap. Chunks ranked before
+    // first_evictable and required chunks are kept. Returns false if there is not enough to evict.
+    bool make_chunk_room(uint64_t bytes, uint32_t first_evictable)
+    {
+        const uint64_t budget = uint64_t(m_chunk_memory_mb) * 1024 * 1024;
+
+        for (uint32_t k = uint32_t(m_chunk_order.size()); k > first_evictable && m_chunk_memory_bytes + bytes > budget; k--)
         {
-            DW_LOG_FATAL("Failed to load mesh!");
-            return false;
+            uint32_t index = m_chunk_order[k - 1];
+
+            if (m_chunks[index].state == CHUNK_RESIDENT && !m_chunk_required[index])
+                evict_chunk(index);
         }
 
-        return true;
+        return m_chunk_memory_bytes + bytes <= budget;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    bool load_decals()
+    void update_chunk_streaming(bool wait)
     {
-        m_decal_textures.resize(4);
-        m_decal_textures[0] = std::unique_ptr<dw::Texture2D>(dw::Texture2D::create_from_files("texture/opengl.png", true));
-        m_decal_textures[0]->set_min_filter(GL_LINEAR_MIPMAP_LINEAR);
-        m_decal_textures[0]->set_mag_filter(GL_LINEAR);
+        const std::vector<MeshChunkDesc>& descs          = m_chunk_file.chunks();
+        const uint32_t                    count          = uint32_t(descs.size());
+        const uint64_t                    budget         = uint64_t(m_chunk_memory_mb) * 1024 * 1024;
+        const glm::mat4                   camera_clip    = m_global_uniforms.view_proj * m_transform;
+        const glm::mat4                   projector_clip = m_global_uniforms.light_view_proj * m_transform;
+        const glm::vec3                   camera_pos     = m_main_camera->m_position;
+        const bool                        has_projector  = m_hit_distance != INFINITY;
+
+        // Chunks under the projector come first, then the visible ones and then the rest, each by distance to the camera.
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const MeshChunkDesc& desc   = descs[i];
+            glm::vec3            lo     = glm::vec3(desc.bounds_min[0], desc.bounds_min[1], desc.bounds_min[2]);
+            glm::vec3            hi     = glm::vec3(desc.bounds_max[0], desc.bounds_max[1], desc.bounds_max[2]);
+            glm::vec3            center = glm::vec3(m_transform * glm::vec4((lo + hi) * 0.5f, 1.0f));
+            float                radius = glm::length(hi - lo) * 0.5f;
+            float                tier   = 2.0f;
+
+            if (has_projector && chunk_overlaps(projector_clip, desc))
+                tier = 0.0f;
+            else if (chunk_overlaps(camera_clip, desc))
+                tier = 1.0f;
+
+            m_chunk_priority[i] = tier * 4.0f * CAMERA_FAR_PLANE + std::max(glm::length(center - camera_pos) - radius, 0.0f);
+        }
+
+        std::sort(m_chunk_order.begin(), m_chunk_order.end(), [&](uint32_t a, uint32_t b) { return m_chunk_priority[a] < m_chunk_priority[b]; });
 
-        m_decal_textures[1] = std::unique_ptr<dw::Texture2D>(dw::Texture2D::create_from_files("texture/vulkan.png", true));
-        m_decal_textures[1]->set_min_filter(GL_LINEAR_MIPMAP_LINEAR);
-        m_decal_textures[1]->set_mag_filter(GL_LINEAR);
+        // The chunks that fit into the budget in order of priority are the ones that should be resident.
+        uint32_t wanted       = 0;
+        uint64_t wanted_bytes = 0;
 
-        m_decal_textures[2] = std::unique_ptr<dw::Texture2D>(dw::Texture2D::create_from_files("texture/directx.png", true));
-        m_decal_textures[2]->set_min_filter(GL_LINEAR_MIPMAP_LINEAR);
-        m_decal_textures[2]->set_mag_filter(GL_LINEAR);
+        for (; wanted < count; wanted++)
+        {
+            uint64_t bytes = chunk_memory_bytes(m_chunk_order[wanted]);
 
-        m_decal_textures[3] = std::unique_ptr<dw::Texture2D>(dw::Texture2D::create_from_files("texture/metal.png", true));
-        m_decal_textures[3]->set_min_filter(GL_LINEAR_MIPMAP_LINEAR);
-        m_decal_textures[3]->set_mag_filter(GL_LINEAR);
+            if (wanted_bytes + bytes > budget)
+                break;
 
-        return true;
+            wanted_bytes += bytes;
+        }
+
+        // The cap may have been lowered.
+        make_chunk_room(0, wanted);
+
+        for (uint32_t k = 0; k < wanted; k++)
+        {
+            uint32_t       index = m_chunk_order[k];
+            StreamedChunk& chunk = m_chunks[index];
+
+            if (chunk.state != CHUNK_UNLOADED || chunk.failed)
+                continue;
+
+            if (!wait && m_chunk_loads_in_flight >= CHUNK_LOADS_IN_FLIGHT)
+                break;
+
+            if (!make_chunk_room(chunk_memory_bytes(index), wanted))
+                break;
+
+            begin_chunk_load(index);
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (m_chunks[i].state == CHUNK_LOADING && (wait || m_chunks[i].load.pending.load(std::memory_order_acquire) == 0))
+                wait_chunk_load(i);
+        }
+
+        if (m_embree_scene_dirty)
+        {
+            commit_embree_scene(m_embree_scene);
+            m_embree_scene_dirty = false;
+        }
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    bool initialize_embree()
+    // Makes every chunk under the projector resident before a decal is applied. If the projector alone covers more than
+    // the cap allows, the cap is exceeded until the next streaming update.
+    void require_chunks(const glm::mat4& view_proj)
     {
-        m_embree_device = rtcNewDevice(nullptr);
+        const std::vector<MeshChunkDesc>& descs = m_chunk_file.chunks();
+        const glm::mat4                   clip  = view_proj * m_transform;
 
-        RTCError embree_error = rtcGetDeviceError(m_embree_device);
+        for (uint32_t i = 0; i < descs.size(); i++)
+            m_chunk_required[i] = !m_chunks[i].failed && chunk_overlaps(clip, descs[i]);
 
-        if (embree_error == RTC_ERROR_UNSUPPORTED_CPU)
-            throw std::runtime_error("Your CPU does not meet the minimum requirements for embree");
-        else if (embree_error != RTC_ERROR_NONE)
-            throw std::runtime_error("Failed to initialize embree!");
+        load_required_chunks();
+    }
 
-        m_embree_scene = rtcNewScene(m_embree_device);
+    // -----------------------------------------------------------------------------------------------------------------------------------
 
-        m_embree_triangle_mesh = rtcNewGeometry(m_embree_device, RTC_GEOMETRY_TYPE_TRIANGLE);
+    // Marks the chunks that a ray enters before the given distance. A hit among the resident chunks is only trusted once
+    // none of them is missing, returns whether any is. The resident ones are marked as well, so that loading the missing
+    // ones cannot evict them.
+    bool mark_nearer_chunks(const glm::vec3& origin, const glm::vec3& dir, float distance)
+    {
+        const std::vector<MeshChunkDesc>& descs     = m_chunk_file.chunks();
+        const glm::mat4                   to_object = m_inv_transform.get(m_transform);
 
-        std::vector<glm::vec3> vertices(m_mesh->vertex_count());
-        std::vector<uint32_t>  indices(m_mesh->index_count());
-        uint32_t               idx        = 0;
-        dw::Vertex*            vertex_ptr = m_mesh->vertices();
-        uint32_t*              index_ptr  = m_mesh->indices();
+        // The direction is not renormalized, so distances along the ray are the same in object space.
+        glm::vec3 o       = glm::vec3(to_object * glm::vec4(origin, 1.0f));
+        glm::vec3 inv_dir = 1.0f / glm::vec3(to_object * glm::vec4(dir, 0.0f));
+        bool      missing = false;
 
-        for (int i = 0; i < m_mesh->vertex_count(); i++)
-            vertices[i] = vertex_ptr[i].position;
+        for (uint32_t i = 0; i < descs.size(); i++)
+        {
+            if (m_chunks[i].failed)
+                continue;
 
-        for (int i = 0; i < m_mesh->sub_mesh_count(); i++)
+            glm::vec3 t0    = (glm::vec3(descs[i].bounds_min[0], descs[i].bounds_min[1], descs[i].bounds_min[2]) - o) * inv_dir;
+            glm::vec3 t1    = (glm::vec3(descs[i].bounds_max[0], descs[i].bounds_max[1], descs[i].bounds_max[2]) - o) * inv_dir;
+            glm::vec3 lo    = glm::min(t0, t1);
+            glm::vec3 hi    = glm::max(t0, t1);
+            float     enter = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+            float     exit  = std::min(std::min(hi.x, hi.y), hi.z);
+
+            if (enter <= exit && enter <= distance)
+            {
+                m_chunk_required[i] = 1;
+                missing             = missing || m_chunks[i].state != CHUNK_RESIDENT;
+            }
+        }
+
+        return missing;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Makes every marked chunk resident and clears the marks. All the loads are started before waiting for any, so that
+    // they read and build their BVHs in parallel.
+    void load_required_chunks()
+    {
+        // Streaming is not part of the per decal allocation count.
+        HeapAllocationCountPause          pause;
+        const std::vector<MeshChunkDesc>& descs = m_chunk_file.chunks();
+
+        for (uint32_t i = 0; i < descs.size(); i++)
         {
-            dw::SubMesh& submesh = m_mesh->sub_meshes()[i];
+            if (m_chunk_required[i] && m_chunks[i].state == CHUNK_UNLOADED)
+            {
+                make_chunk_room(chunk_memory_bytes(i), 0);
+                begin_chunk_load(i);
+            }
+        }
 
-            for (int j = submesh.base_index; j < (submesh.base_index + submesh.index_count); j++)
-                indices[idx++] = submesh.base_vertex + index_ptr[j];
+        for (uint32_t i = 0; i < descs.size(); i++)
+        {
+            if (m_chunk_required[i] && m_chunks[i].state == CHUNK_LOADING)
+                wait_chunk_load(i);
         }
 
-        void* data = rtcSetNewGeometryBuffer(m_embree_triangle_mesh, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, sizeof(glm::vec3), m_mesh->vertex_count());
-        memcpy(data, vertices.data(), vertices.size() * sizeof(glm::vec3));
+        std::fill(m_chunk_required.begin(), m_chunk_required.end(), 0);
 
-        data = rtcSetNewGeometryBuffer(m_embree_triangle_mesh, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, 3 * sizeof(uint32_t), m_mesh->index_count() / 3);
-        memcpy(data, indices.data(), indices.size() * sizeof(uint32_t));
+        // Later picks in the same frame have to see the new chunks.
+        if (m_embree_scene_dirty)
+        {
+            commit_embree_scene(m_embree_scene);
+            m_embree_scene_dirty = false;
+        }
+    }
 
-        rtcCommitGeometry(m_embree_triangle_mesh);
-        rtcAttachGeometry(m_embree_scene, m_embree_triangle_mesh);
-        rtcCommitScene(m_embree_scene);
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Draws every chunk of the mesh, passing the ones that are not resident through temporary buffers one at a time.
+    void draw_all_chunks()
+    {
+        const std::vector<MeshChunkDesc>& descs = m_chunk_file.chunks();
+        MeshChunkData                     data;
+        StreamedChunk                     temporary;
 
-        rtcInitIntersectContext(&m_embree_intersect_context);
+        for (uint32_t i = 0; i < descs.size(); i++)
+        {
+            StreamedChunk* chunk = &m_chunks[i];
 
-        return true;
+            if (chunk->state != CHUNK_RESIDENT)
+            {
+                if (!m_chunk_file.read_chunk(i, data))
+                    continue;
+
+                create_chunk_vertex_array(data, temporary);
+                chunk = &temporary;
+            }
+
+            chunk->vao->bind();
+
+            // Issue draw call.
+            glDrawElements(GL_TRIANGLES, descs[i].index_count, GL_UNSIGNED_INT, nullptr);
+        }
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     void create_camera()
     {
-        m_main_camera = std::make_unique<dw::Camera>(60.0f, 0.1f, CAMERA_FAR_PLANE, float(m_width) / float(m_height), glm::vec3(150.0f, 20.0f, 0.0f), glm::vec3(-1.0f, 0.0, 0.0f));
+        m_main_camera = std::make_unique<dw::Camera>(CAMERA_FOV, 0.1f, CAMERA_FAR_PLANE, float(m_width) / float(m_height), glm::vec3(150.0f, 20.0f, 0.0f), glm::vec3(-1.0f, 0.0, 0.0f));
         m_main_camera->set_rotatation_delta(glm::vec3(0.0f, -90.0f, 0.0f));
         m_main_camera->update();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_mesh(dw::Mesh* mesh, glm::mat4 model, std::unique_ptr<dw::Program>& program)
+    void render_mesh(dw::VertexArray* vao, glm::mat4 model, const glm::mat4& view_proj, std::unique_ptr<dw::Program>& program)
     {
         program->set_uniform("u_Model", model);
 
+        for (uint32_t i = 0; i < DECAL_CHANNEL_COUNT; i++)
+        {
+            if (program->set_uniform(DECAL_CHANNELS[i].atlas_sampler, i))
+                m_atlas_textures[i]->bind(i);
+        }
+
+        draw_mesh(vao, view_proj);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Issues the draw calls for the mesh. A streamed mesh only draws its resident chunks that overlap the given view.
+    void draw_mesh(dw::VertexArray* vao, const glm::mat4& view_proj)
+    {
+        if (is_streaming_mesh())
+        {
+            const std::vector<MeshChunkDesc>& descs = m_chunk_file.chunks();
+            glm::mat4                         clip  = view_proj * m_transform;
+
+            for (uint32_t i = 0; i < descs.size(); i++)
+            {
+                if (m_chunks[i].state != CHUNK_RESIDENT || !chunk_overlaps(clip, descs[i]))
+                    continue;
+
+                m_chunks[i].vao->bind();
+
+                // Issue draw call.
+                glDrawElements(GL_TRIANGLES, descs[i].index_count, GL_UNSIGNED_INT, nullptr);
+            }
+
+            return;
+        }
+
         // Bind vertex array.
-        mesh->mesh_vertex_array()->bind();
+        vao->bind();
 
-        dw::SubMesh* submeshes = mesh->sub_meshes();
+        dw::SubMesh* submeshes = m_mesh->sub_meshes();
 
-        for (uint32_t i = 0; i < mesh->sub_mesh_count(); i++)
+        for (uint32_t i = 0; i < m_mesh->sub_mesh_count(); i++)
         {
             dw::SubMesh& submesh = submeshes[i];
 
-            if (program->set_uniform("s_Texture", 0))
-                m_albedo_texture->bind(0);
-
             // Issue draw call.
             glDrawElementsBaseVertex(GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
         }
@@ -718,7 +3630,7 @@ private:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render_scene(dw::Framebuffer* fbo, std::unique_ptr<dw::Program>& program, int x, int y, int w, int h, GLenum cull_face, bool clear = true)
+    void render_scene(dw::Framebuffer* fbo, std::unique_ptr<dw::Program>& program, dw::VertexArray* vao, const glm::mat4& view_proj, int x, int y, int w, int h, GLenum cull_face, bool clear = true)
     {
         glEnable(GL_DEPTH_TEST);
         glDisable(GL_BLEND);
@@ -749,19 +3661,44 @@ private:
         program->use();
 
         // Bind uniform buffers.
-        m_global_ubo->bind_base(0);
+        bind_global_uniforms();
 
         // Draw scene.
-        render_mesh(m_mesh, m_transform, program);
+        render_mesh(vao, m_transform, view_proj, program);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
+    // Each update writes a slice that no queued draw reads, so applying many decals in a frame does not wait on the GPU
+    // between them. Wrapping around orphans the whole buffer instead, which lets the driver hand out fresh storage.
     void update_global_uniforms(const GlobalUniforms& global)
     {
-        void* ptr = m_global_ubo->map(GL_WRITE_ONLY);
+        if (m_global_ubo_slice == GLOBAL_UBO_SLICES)
+            m_global_ubo_slice = 0;
+
+        GLbitfield access = GL_MAP_WRITE_BIT;
+
+        if (m_global_ubo_slice == 0)
+            access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+        else
+            access |= GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+        m_global_ubo_offset = m_global_ubo_slice++ * m_global_ubo_stride;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, m_global_ubo->id());
+        void* ptr = glMapBufferRange(GL_UNIFORM_BUFFER, m_global_ubo_offset, sizeof(GlobalUniforms), access);
         memcpy(ptr, &global, sizeof(GlobalUniforms));
-        m_global_ubo->unmap();
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        bind_global_uniforms();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void bind_global_uniforms()
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, m_global_ubo->id(), m_global_ubo_offset, sizeof(GlobalUniforms));
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -778,8 +3715,9 @@ private:
 
         glm::vec4 rotated_axis = rotate * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
 
-        float ratio                = float(m_decal_textures[m_selected_decal]->height()) / float(m_decal_textures[m_selected_decal]->width());
-        float proportionate_height = m_projector_size * ratio;
+        dw::Texture2D* decal                = m_decal_assets[m_selected_decal].layers[DECAL_CHANNEL_ALBEDO].get();
+        float          ratio                = float(decal->height()) / float(decal->width());
+        float          proportionate_height = m_projector_size * ratio;
 
         m_projector_view = glm::lookAt(m_projector_pos, m_hit_pos, glm::vec3(rotated_axis));
         m_projector_proj = glm::ortho(-m_projector_size, m_projector_size, -proportionate_height, proportionate_height, 0.1f, CAMERA_FAR_PLANE);
@@ -794,8 +3732,13 @@ private:
     {
         dw::Camera* current = m_main_camera.get();
 
-        float forward_delta = m_heading_speed * m_delta;
-        float right_delta   = m_sideways_speed * m_delta;
+        // The frame after an idle wait would otherwise move the camera by the whole time spent waiting.
+        float delta = m_woke_from_idle ? 0.0f : float(m_delta);
+
+        m_woke_from_idle = false;
+
+        float forward_delta = m_heading_speed * delta;
+        float right_delta   = m_sideways_speed * delta;
 
         current->set_translation_delta(current->m_forward, forward_delta);
         current->set_translation_delta(current->m_right, right_delta);
@@ -834,30 +3777,64 @@ private:
     std::unique_ptr<dw::Shader> m_visualize_fs;
     std::unique_ptr<dw::Shader> m_depth_vs;
     std::unique_ptr<dw::Shader> m_depth_fs;
+    std::unique_ptr<dw::Shader> m_composite_fs;
 
     std::unique_ptr<dw::Program> m_texture_init_program;
     std::unique_ptr<dw::Program> m_decal_program;
     std::unique_ptr<dw::Program> m_mesh_program;
     std::unique_ptr<dw::Program> m_visualize_program;
     std::unique_ptr<dw::Program> m_depth_program;
+    std::unique_ptr<dw::Program> m_decal_composite_program;
 
-    std::unique_ptr<dw::Texture2D>              m_albedo_texture;
-    std::vector<std::unique_ptr<dw::Texture2D>> m_decal_textures;
-    std::unique_ptr<dw::Texture2D>              m_depth_texture;
+    std::unique_ptr<dw::Texture2D> m_atlas_textures[DECAL_CHANNEL_COUNT];
+    std::unique_ptr<dw::Texture2D> m_scratch_textures[DECAL_CHANNEL_COUNT];
+    std::vector<DecalAsset>        m_decal_assets;
+    std::unique_ptr<dw::Texture2D> m_depth_texture;
+    std::unique_ptr<dw::Texture2D> m_scene_color;
+    std::unique_ptr<dw::Texture2D> m_scene_depth;
 
-    std::unique_ptr<dw::Framebuffer> m_albedo_fbo;
+    std::unique_ptr<dw::Framebuffer> m_atlas_fbo;
     std::unique_ptr<dw::Framebuffer> m_depth_fbo;
+    std::unique_ptr<dw::Framebuffer> m_scene_fbo;
+    GLuint                           m_lod_read_fbo = 0;
+    GLuint                           m_lod_draw_fbo = 0;
 
     std::unique_ptr<dw::UniformBuffer> m_global_ubo;
+    GLintptr                           m_global_ubo_stride = 0;
+    GLintptr                           m_global_ubo_offset = 0;
+    uint32_t                           m_global_ubo_slice  = 0;
+
+    // Position/UV-only vertex stream.
+    std::unique_ptr<dw::VertexBuffer> m_slim_vbo;
+    std::unique_ptr<dw::IndexBuffer>  m_slim_ibo;
+    std::unique_ptr<dw::VertexArray>  m_slim_vao;
 
     // Camera.
     std::unique_ptr<dw::Camera> m_main_camera;
+    CachedInverse               m_inv_view;
+    CachedInverse               m_inv_projection;
 
     GlobalUniforms m_global_uniforms;
 
     // Scene
-    dw::Mesh* m_mesh;
-    glm::mat4 m_transform;
+    dw::Mesh*     m_mesh = nullptr;
+    glm::mat4     m_transform;
+    CachedInverse m_inv_transform;
+
+    // Streamed mesh
+    MeshChunkFile                    m_chunk_file;
+    std::unique_ptr<StreamedChunk[]> m_chunks;
+    std::vector<uint32_t>            m_chunk_order;
+    std::vector<float>               m_chunk_priority;
+    std::vector<uint8_t>             m_chunk_required;
+    int32_t                          m_chunk_memory_mb       = CHUNK_DEFAULT_MEMORY_MB;
+    uint64_t                         m_chunk_memory_bytes    = 0;
+    uint32_t                         m_chunk_loads_in_flight = 0;
+    uint32_t                         m_resident_chunks       = 0;
+    uint64_t                         m_chunk_loads           = 0;
+    uint64_t                         m_chunk_evictions       = 0;
+    uint64_t                         m_geometry_version      = 0;
+    bool                             m_embree_scene_dirty    = false;
 
     // Camera controls.
     bool  m_mouse_look         = false;
@@ -869,10 +3846,46 @@ private:
     bool  m_debug_gui          = true;
 
     // Embree structure
-    RTCDevice           m_embree_device        = nullptr;
-    RTCScene            m_embree_scene         = nullptr;
-    RTCGeometry         m_embree_triangle_mesh = nullptr;
-    RTCIntersectContext m_embree_intersect_context;
+    RTCDevice   m_embree_device        = nullptr;
+    RTCScene    m_embree_scene         = nullptr;
+    RTCGeometry m_embree_triangle_mesh = nullptr;
+
+    // Render on demand
+    bool       m_render_on_demand  = true;
+    bool       m_idle_mode         = true;
+    bool       m_idle_waited       = false;
+    bool       m_woke_from_idle    = false;
+    bool       m_frame_state_valid = false;
+    FrameState m_last_frame_state;
+    uint64_t   m_atlas_version    = 0;
+    uint32_t   m_unchanged_frames = 0;
+    uint64_t   m_frames_rendered  = 0;
+    uint64_t   m_frames_presented = 0;
+    uint64_t   m_idle_waits       = 0;
+
+    // Headless benchmark
+    bool                                           m_headless        = false;
+    uint32_t                                       m_headless_frames = 0;
+    uint32_t                                       m_headless_decals = 0;
+    uint32_t                                       m_headless_target = 0;
+    std::mt19937                                   m_headless_rng;
+    std::vector<GLuint>                            m_depth_queries;
+    std::vector<GLuint>                            m_decal_queries;
+    std::vector<double>                            m_frame_times_ms;
+    std::chrono::high_resolution_clock::time_point m_frame_start;
+    std::chrono::high_resolution_clock::time_point m_run_start;
+
+    // Task scheduler
+    TaskScheduler                m_scheduler;
+    std::vector<TaskWorkerStats> m_scheduler_stats;
+    uint32_t                     m_thread_count = 0;
+    bool                         m_pin_threads  = false;
+
+    // External decal submission
+    DecalSubmissionService   m_submission_service;
+    std::vector<DecalRecord> m_submitted_decals;
+    std::vector<RayHit>      m_submitted_hits;
+    std::vector<uint8_t>     m_submitted_retrace;
 
     // Last hit
     glm::vec3 m_hit_pos;
@@ -880,25 +3893,177 @@ private:
     float     m_hit_distance = INFINITY;
 
     // Projector
-    glm::vec3 m_projector_pos;
-    glm::vec3 m_projector_dir;
-    glm::mat4 m_projector_view;
-    glm::mat4 m_projector_proj;
-    float     m_projector_size     = 10.0f;
-    float     m_projector_rotation = 0.0f;
-    bool      m_requires_update    = false;
+    glm::vec3     m_projector_pos;
+    glm::vec3     m_projector_dir;
+    glm::mat4     m_projector_view;
+    glm::mat4     m_projector_proj;
+    CachedInverse m_inv_projector_view;
+    float         m_projector_size     = 10.0f;
+    float         m_projector_rotation = 0.0f;
+    bool          m_requires_update    = false;
+    std::mt19937  m_decal_rng;
+    std::string   m_decal_sampler_names[DECAL_CHANNEL_COUNT];
+
+    // Transient decal data
+    FrameArena m_frame_arena { FRAME_ARENA_SIZE };
+    uint64_t   m_decals_measured        = 0;
+    uint64_t   m_last_decal_allocations = 0;
+    uint64_t   m_warm_decal_allocations = 0;
 
     // Debug
     bool    m_visualize_albedo_map         = true;
+    int32_t m_visualized_channel           = DECAL_CHANNEL_ALBEDO;
     bool    m_visualize_projection_frustum = false;
     bool    m_visualize_hit_point          = false;
     bool    m_enable_conservative_raster   = true;
     bool    m_randomize_decals             = true;
     int32_t m_selected_decal               = 0;
+    bool    m_use_slim_vertex_stream       = true;
+
+    // Decal LOD
+    bool                  m_enable_decal_lod     = true;
+    float                 m_decal_lod_bias       = -1.0f;
+    float                 m_texel_density        = 1.0f;
+    float                 m_uv_density           = 0.0f;
+    float                 m_target_texel_density = DEFAULT_TARGET_TEXEL_DENSITY;
+    uint32_t              m_atlas_size           = MAX_ATLAS_SIZE;
+    int32_t               m_albedo_mip_levels    = 1;
+    int32_t               m_last_decal_lod       = 0;
+    uint64_t              m_decal_texels_written = 0;
+    uint64_t              m_decals_applied       = 0;
+    uint64_t              m_lod_refinements      = 0;
+    std::vector<LodDecal> m_lod_decals;
+
+    // Undo history
+    HistoryStack                 m_undo_stack { HISTORY_UNDO_ARENA_SIZE };
+    HistoryStack                 m_redo_stack { HISTORY_REDO_ARENA_SIZE };
+    HistoryReadback              m_open_readback;
+    std::deque<HistoryReadback>  m_pending_readbacks;
+    std::vector<HistoryReadback> m_free_readbacks;
+    std::vector<GLuint>          m_free_pbos;
+    std::vector<bool>            m_tile_captured;
+    std::vector<HistoryTile>     m_history_tiles;
+    std::vector<uint8_t>         m_history_blob;
+    std::vector<uint8_t>         m_history_step_data;
+    std::vector<uint8_t>         m_history_tile_data;
+    std::deque<HistoryBatch>     m_undo_batches;
+    std::deque<HistoryBatch>     m_redo_batches;
+    uint32_t                     m_history_batch       = 1;
+    bool                         m_batch_has_decals    = false;
+    int32_t                      m_history_tile_levels = 1;
+    size_t                       m_history_tile_bytes  = 0;
+    size_t                       m_last_step_bytes     = 0;
+    size_t                       m_last_step_raw_bytes = 0;
+    uint32_t                     m_last_step_tiles     = 0;
+    double                       m_last_undo_ms        = 0.0;
+
+    // Distant impact benchmark
+    bool   m_distant_impact_benchmarked = false;
+    double m_distant_impact_texels[2]   = { 0.0, 0.0 };
+    double m_distant_impact_ms[2]       = { 0.0, 0.0 };
+
+    // Vertex stream benchmark
+    // Indexed by [stream][order]: full then slim, original then reordered triangles.
+    bool  m_vertex_stream_benchmarked = false;
+    float m_original_acmr             = 0.0f;
+    float m_optimized_acmr            = 0.0f;
+    float m_stream_fetch_mb[2][2]     = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+    float m_stream_ms[2][2]           = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
 
     // Camera orientation.
     float m_camera_x;
     float m_camera_y;
 };
 
-DW_DECLARE_MAIN(TextureSpaceDecals)
\ No newline at end of file
+// The whole argument has to be a finite number. std::stof throws on garbage instead and ignores trailing characters.
+static bool parse_float(const char* str, float& value)
+{
+    char* end = nullptr;
+
+    errno = 0;
+    value = strtof(str, &end);
+
+    return end != str && *end == '\0' && errno == 0 && std::isfinite(value);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Same for a decimal count. strtoul would accept a sign and wrap negative values around, so digits are required.
+static bool parse_uint(const char* str, uint32_t& value)
+{
+    if (*str < '0' || *str > '9')
+        return false;
+
+    char* end = nullptr;
+
+    errno = 0;
+    unsigned long parsed = strtoul(str, &end, 10);
+
+    if (*end != '\0' || errno != 0 || parsed > UINT32_MAX)
+        return false;
+
+    value = uint32_t(parsed);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool parse_launch_options(int argc, const char* argv[], LaunchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg       = argv[i];
+        bool        has_value = i + 1 < argc;
+        bool        valid     = true;
+
+        if (arg == "--texel-density" && has_value)
+            valid = parse_float(argv[++i], options.texel_density) && options.texel_density > 0.0f;
+        else if (arg == "--threads" && has_value)
+            valid = parse_uint(argv[++i], options.thread_count);
+        else if (arg == "--pin-threads")
+            options.pin_threads = true;
+        else if (arg == "--headless")
+            options.headless = true;
+        else if (arg == "--frames" && has_value)
+            valid = parse_uint(argv[++i], options.frames);
+        else if (arg == "--decals" && has_value)
+            valid = parse_uint(argv[++i], options.decals);
+        else if (arg == "--decals-per-frame" && has_value)
+            valid = parse_uint(argv[++i], options.decals_per_frame) && options.decals_per_frame > 0;
+        else if (arg == "--dump" && has_value)
+            options.dump_prefix = argv[++i];
+        else if (arg == "--report" && has_value)
+            options.report_path = argv[++i];
+        else if (arg == "--mesh" && has_value)
+            options.mesh_path = argv[++i];
+        else if (arg == "--mesh-memory-mb" && has_value)
+            valid = parse_uint(argv[++i], options.mesh_memory_mb) && options.mesh_memory_mb > 0 && options.mesh_memory_mb <= CHUNK_MAX_MEMORY_MB;
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+    if (!parse_launch_options(argc, argv, g_launch_options))
+        return 1;
+
+#if defined(GLFW_PLATFORM_NULL)
+    // GLFW's null platform needs no display, and creates its contexts through OSMesa (llvmpipe or softpipe).
+    if (g_launch_options.headless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
+    TextureSpaceDecals app;
+    return app.run(argc, argv);
+}
\ No newline at end of file
@@ -0,0 +1,201 @@
+// Stand-alone chunk baker. Converts a Wavefront OBJ into a chunk file that TextureSpaceDecals streams from with --mesh,
+// and can write a large synthetic OBJ to measure how the bake and the streamer scale. Both report their peak RSS.
+
+#include "mesh_chunks.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <chrono>
+
+#define SYNTHETIC_SPACING 0.5f
+#define SYNTHETIC_AMPLITUDE 4.0f
+#define SYNTHETIC_FREQUENCY 0.05f
+// Largest grid whose (resolution + 1)^2 vertices can still be referenced by 32-bit OBJ indices.
+#define SYNTHETIC_MAX_RESOLUTION 65534
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void print_usage()
+{
+    printf("usage: MeshChunkBake input.obj output.chunks [--triangles count] [--cache-mb size]\n");
+    printf("       MeshChunkBake --synthetic resolution output.obj\n");
+    printf("  --triangles  Target triangles per chunk (default: %d)\n", MESH_CHUNK_DEFAULT_TRIANGLES);
+    printf("  --cache-mb   Memory for the vertex caches used while baking (default: %d)\n", MESH_CHUNK_DEFAULT_CACHE_MB);
+    printf("  --synthetic  Writes a displaced grid of resolution x resolution quads centered on the origin (at most %d)\n", SYNTHETIC_MAX_RESOLUTION);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The whole argument has to be a decimal count. atoi would silently turn garbage into 0 and negative values into huge
+// ones.
+static bool parse_uint(const char* str, uint32_t& value)
+{
+    if (*str < '0' || *str > '9')
+        return false;
+
+    char* end = nullptr;
+
+    errno = 0;
+    unsigned long parsed = strtoul(str, &end, 10);
+
+    if (*end != '\0' || errno != 0 || parsed > UINT32_MAX)
+        return false;
+
+    value = uint32_t(parsed);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float synthetic_height(float x, float z)
+{
+    return SYNTHETIC_AMPLITUDE * (sinf(x * SYNTHETIC_FREQUENCY) * cosf(z * SYNTHETIC_FREQUENCY) + 0.25f * sinf((x + z) * SYNTHETIC_FREQUENCY * 4.0f));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Streams the grid out row by row so that writing it takes no memory regardless of the resolution.
+static bool write_synthetic_obj(const std::string& path, uint32_t resolution)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    uint32_t row    = resolution + 1;
+    float    extent = float(resolution) * SYNTHETIC_SPACING;
+
+    for (uint32_t z = 0; z < row; z++)
+    {
+        for (uint32_t x = 0; x < row; x++)
+        {
+            float px = float(x) * SYNTHETIC_SPACING - extent * 0.5f;
+            float pz = float(z) * SYNTHETIC_SPACING - extent * 0.5f;
+
+            fprintf(file, "v %.4f %.4f %.4f\n", px, synthetic_height(px, pz), pz);
+        }
+    }
+
+    for (uint32_t z = 0; z < row; z++)
+    {
+        for (uint32_t x = 0; x < row; x++)
+            fprintf(file, "vt %.6f %.6f\n", float(x) / float(resolution), float(z) / float(resolution));
+    }
+
+    for (uint32_t z = 0; z < row; z++)
+    {
+        for (uint32_t x = 0; x < row; x++)
+        {
+            float px = float(x) * SYNTHETIC_SPACING - extent * 0.5f;
+            float pz = float(z) * SYNTHETIC_SPACING - extent * 0.5f;
+            float dx = synthetic_height(px + SYNTHETIC_SPACING, pz) - synthetic_height(px - SYNTHETIC_SPACING, pz);
+            float dz = synthetic_height(px, pz + SYNTHETIC_SPACING) - synthetic_height(px, pz - SYNTHETIC_SPACING);
+            float nx = -dx;
+            float ny = 2.0f * SYNTHETIC_SPACING;
+            float nz = -dz;
+            float l  = sqrtf(nx * nx + ny * ny + nz * nz);
+
+            fprintf(file, "vn %.4f %.4f %.4f\n", nx / l, ny / l, nz / l);
+        }
+    }
+
+    // Counter-clockwise when seen from above.
+    for (uint32_t z = 0; z < resolution; z++)
+    {
+        for (uint32_t x = 0; x < resolution; x++)
+        {
+            uint32_t i0 = z * row + x + 1;
+            uint32_t i1 = i0 + 1;
+            uint32_t i2 = i0 + row;
+            uint32_t i3 = i2 + 1;
+
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i0, i0, i0, i2, i2, i2, i1, i1, i1);
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i1, i1, i1, i2, i2, i2, i3, i3, i3);
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+    const char* input               = nullptr;
+    const char* output              = nullptr;
+    uint32_t    triangles_per_chunk = MESH_CHUNK_DEFAULT_TRIANGLES;
+    uint32_t    cache_mb            = MESH_CHUNK_DEFAULT_CACHE_MB;
+    uint32_t    synthetic           = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool valid = true;
+
+        if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc)
+            valid = parse_uint(argv[++i], triangles_per_chunk) && triangles_per_chunk > 0;
+        else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc)
+            valid = parse_uint(argv[++i], cache_mb) && cache_mb > 0;
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+            valid = parse_uint(argv[++i], synthetic) && synthetic > 0 && synthetic <= SYNTHETIC_MAX_RESOLUTION;
+        else if (argv[i][0] != '-' && !input)
+            input = argv[i];
+        else if (argv[i][0] != '-' && !output)
+            output = argv[i];
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (synthetic > 0)
+    {
+        if (!input || output)
+        {
+            print_usage();
+            return 1;
+        }
+
+        if (!write_synthetic_obj(input, synthetic))
+        {
+            printf("Failed to write %s\n", input);
+            return 1;
+        }
+
+        printf("Wrote %s: %llu triangles\n", input, 2ull * synthetic * synthetic);
+    }
+    else
+    {
+        if (!input || !output)
+        {
+            print_usage();
+            return 1;
+        }
+
+        MeshChunkBakeStats stats;
+
+        if (!bake_mesh_chunks(input, output, triangles_per_chunk, cache_mb, stats))
+        {
+            printf("Failed to bake %s into %s\n", input, output);
+            return 1;
+        }
+
+        printf("Baked %s into %s: %llu triangles, %llu OBJ vertices -> %u chunks (largest %u triangles), %llu chunk vertices\n", input, output, (unsigned long long)stats.triangles, (unsigned long long)stats.obj_vertices, stats.chunks, stats.largest_chunk, (unsigned long long)stats.chunk_vertices);
+
+        if (stats.skipped_faces > 0)
+            printf("Skipped %llu malformed faces\n", (unsigned long long)stats.skipped_faces);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Time: %.2f s, peak RSS: %.1f MB\n", seconds, double(peak_rss_bytes()) / (1024.0 * 1024.0));
+
+    return 0;
+}
@@ -0,0 +1,902 @@
+#include "mesh_chunks.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <unordered_map>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Multiple of every record size read through the block cache (12 and 8 bytes), so records never straddle two blocks.
+#define BAKE_BLOCK_SIZE (96 * 1024)
+#define BAKE_CELLS_PER_CHUNK 64
+#define BAKE_MAX_CELLS (1u << 22)
+#define BAKE_MAX_CELLS_PER_AXIS 1024
+#define BAKE_SCATTER_TRIANGLES 256
+#define BAKE_MIN_CHUNK_TRIANGLES 1024
+#define BAKE_STREAM_BUFFER_SIZE (1024 * 1024)
+#define INVALID_INDEX 0xFFFFFFFFu
+
+struct ObjCorner
+{
+    uint32_t v;
+    uint32_t vt;
+    uint32_t vn;
+
+    bool operator==(const ObjCorner& other) const
+    {
+        return v == other.v && vt == other.vt && vn == other.vn;
+    }
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner& corner) const
+    {
+        uint64_t h = uint64_t(corner.v) * 0x9E3779B97F4A7C15ull;
+        h ^= (uint64_t(corner.vt) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2));
+        h ^= (uint64_t(corner.vn) + 0x85EBCA77C2B2AE63ull + (h << 6) + (h >> 2));
+        return size_t(h);
+    }
+};
+
+struct ObjTriangle
+{
+    ObjCorner corners[3];
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool seek_file(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, int64_t(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t tell_file(FILE* file)
+{
+#if defined(_WIN32)
+    return uint64_t(_ftelli64(file));
+#else
+    return uint64_t(ftello(file));
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Random access to the records of a scratch file through a small direct mapped cache of fixed size blocks. Faces mostly
+// reference recently declared vertices, so even a small cache hits almost every time.
+class BlockReader
+{
+public:
+    ~BlockReader()
+    {
+        close();
+    }
+
+    bool open(const std::string& path, uint32_t block_count)
+    {
+        m_file = fopen(path.c_str(), "rb");
+
+        if (!m_file)
+            return false;
+
+        m_block_count = std::max(block_count, 1u);
+        m_data.resize(size_t(m_block_count) * BAKE_BLOCK_SIZE);
+        m_tags.assign(m_block_count, UINT64_MAX);
+
+        return true;
+    }
+
+    const uint8_t* read(uint64_t offset)
+    {
+        uint64_t block = offset / BAKE_BLOCK_SIZE;
+        uint32_t slot  = uint32_t(block % m_block_count);
+        uint8_t* data  = &m_data[size_t(slot) * BAKE_BLOCK_SIZE];
+
+        if (m_tags[slot] != block)
+        {
+            // The last block may be short, the rest of the slot is never read.
+            seek_file(m_file, block * BAKE_BLOCK_SIZE);
+            fread(data, 1, BAKE_BLOCK_SIZE, m_file);
+
+            m_tags[slot] = block;
+        }
+
+        return data + offset % BAKE_BLOCK_SIZE;
+    }
+
+    // Closes the file and frees the cache.
+    void close()
+    {
+        if (m_file)
+            fclose(m_file);
+
+        m_file = nullptr;
+        std::vector<uint8_t>().swap(m_data);
+        std::vector<uint64_t>().swap(m_tags);
+    }
+
+private:
+    FILE*                 m_file        = nullptr;
+    uint32_t              m_block_count = 0;
+    std::vector<uint8_t>  m_data;
+    std::vector<uint64_t> m_tags;
+};
+
+// Scratch files are removed however the bake ends.
+struct ScratchFiles
+{
+    std::string positions;
+    std::string tex_coords;
+    std::string normals;
+    std::string triangles;
+    std::string cells;
+    std::string sorted;
+
+    ~ScratchFiles()
+    {
+        remove(positions.c_str());
+        remove(tex_coords.c_str());
+        remove(normals.c_str());
+        remove(triangles.c_str());
+        remove(cells.c_str());
+        remove(sorted.c_str());
+    }
+};
+
+struct ObjScan
+{
+    uint64_t positions     = 0;
+    uint64_t tex_coords    = 0;
+    uint64_t normals       = 0;
+    uint64_t triangles     = 0;
+    uint64_t skipped       = 0;
+    float    bounds_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float    bounds_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static FILE* open_stream(const std::string& path, const char* mode)
+{
+    FILE* file = fopen(path.c_str(), mode);
+
+    if (file)
+        setvbuf(file, nullptr, _IOFBF, BAKE_STREAM_BUFFER_SIZE);
+
+    return file;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Parses one OBJ index, which is 1-based or relative to the end when negative. A missing index is INVALID_INDEX.
+static bool parse_obj_index(const char*& p, uint64_t count, uint32_t& index)
+{
+    // strtol would skip the whitespace before the next corner.
+    if ((*p < '0' || *p > '9') && *p != '-')
+    {
+        index = INVALID_INDEX;
+        return true;
+    }
+
+    char* end;
+    long  value = strtol(p, &end, 10);
+
+    if (end == p)
+    {
+        index = INVALID_INDEX;
+        return true;
+    }
+
+    p = end;
+
+    int64_t resolved = value > 0 ? int64_t(value) - 1 : int64_t(count) + value;
+
+    if (value == 0 || resolved < 0 || uint64_t(resolved) >= count)
+        return false;
+
+    index = uint32_t(resolved);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool parse_obj_corner(const char*& p, const ObjScan& scan, ObjCorner& corner)
+{
+    corner.vt = INVALID_INDEX;
+    corner.vn = INVALID_INDEX;
+
+    if (!parse_obj_index(p, scan.positions, corner.v) || corner.v == INVALID_INDEX)
+        return false;
+
+    if (*p == '/')
+    {
+        p++;
+
+        if (!parse_obj_index(p, scan.tex_coords, corner.vt))
+            return false;
+
+        if (*p == '/')
+        {
+            p++;
+
+            if (!parse_obj_index(p, scan.normals, corner.vn))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// First pass: streams the OBJ into flat scratch files of positions, texture coordinates, normals and triangles.
+static bool split_obj(const std::string& obj_path, const ScratchFiles& scratch, ObjScan& scan)
+{
+    FILE* obj        = open_stream(obj_path, "rb");
+    FILE* positions  = open_stream(scratch.positions, "wb");
+    FILE* tex_coords = open_stream(scratch.tex_coords, "wb");
+    FILE* normals    = open_stream(scratch.normals, "wb");
+    FILE* triangles  = open_stream(scratch.triangles, "wb");
+    bool  success    = obj && positions && tex_coords && normals && triangles;
+
+    std::vector<char> line(4096);
+
+    while (success && fgets(line.data(), int(line.size()), obj))
+    {
+        size_t length = strlen(line.data());
+
+        // Keep reading polygons that do not fit into the buffer.
+        while (length == line.size() - 1 && line[length - 1] != '\n')
+        {
+            line.resize(line.size() * 2);
+
+            if (!fgets(&line[length], int(line.size() - length), obj))
+                break;
+
+            length += strlen(&line[length]);
+        }
+
+        const char* p = line.data();
+
+        if (p[0] == 'v' && p[1] == ' ')
+        {
+            float v[3];
+
+            p += 2;
+
+            for (int i = 0; i < 3; i++)
+            {
+                char* end;
+                v[i] = strtof(p, &end);
+                p    = end;
+
+                scan.bounds_min[i] = std::min(scan.bounds_min[i], v[i]);
+                scan.bounds_max[i] = std::max(scan.bounds_max[i], v[i]);
+            }
+
+            fwrite(v, sizeof(v), 1, positions);
+            scan.positions++;
+        }
+        else if (p[0] == 'v' && p[1] == 't' && p[2] == ' ')
+        {
+            float vt[2];
+            char* end;
+
+            vt[0] = strtof(p + 3, &end);
+            vt[1] = strtof(end, &end);
+
+            fwrite(vt, sizeof(vt), 1, tex_coords);
+            scan.tex_coords++;
+        }
+        else if (p[0] == 'v' && p[1] == 'n' && p[2] == ' ')
+        {
+            float vn[3];
+            char* end;
+
+            vn[0] = strtof(p + 3, &end);
+            vn[1] = strtof(end, &end);
+            vn[2] = strtof(end, &end);
+
+            fwrite(vn, sizeof(vn), 1, normals);
+            scan.normals++;
+        }
+        else if (p[0] == 'f' && p[1] == ' ')
+        {
+            ObjTriangle triangle;
+            uint32_t    corners = 0;
+            bool        valid   = true;
+
+            p += 2;
+
+            // Polygons are triangulated as a fan around their first corner.
+            while (valid)
+            {
+                while (*p == ' ' || *p == '\t')
+                    p++;
+
+                if (*p == '\0' || *p == '\n' || *p == '\r')
+                    break;
+
+                ObjCorner corner;
+
+                valid = parse_obj_corner(p, scan, corner);
+
+                if (!valid)
+                    break;
+
+                if (corners < 2)
+                    triangle.corners[corners] = corner;
+                else
+                {
+                    if (corners > 2)
+                        triangle.corners[1] = triangle.corners[2];
+
+                    triangle.corners[2] = corner;
+
+                    fwrite(&triangle, sizeof(triangle), 1, triangles);
+                    scan.triangles++;
+                }
+
+                corners++;
+            }
+
+            if (!valid)
+                scan.skipped++;
+        }
+    }
+
+    if (obj)
+        fclose(obj);
+
+    for (FILE* file : { positions, tex_coords, normals, triangles })
+    {
+        if (file && fclose(file) != 0)
+            success = false;
+    }
+
+    return success && scan.triangles > 0 && scan.triangles < UINT32_MAX;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t spread_bits(uint32_t x)
+{
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Uniform grid over the bounds, with roughly cubic cells that are much smaller than a chunk. Chunks are then cut from the
+// occupied cells laid out along a Morton curve, which keeps them compact.
+struct BakeGrid
+{
+    float    origin[3];
+    float    inv_cell_size;
+    uint32_t dims[3];
+
+    void init(const ObjScan& scan, uint32_t triangles_per_chunk)
+    {
+        uint64_t target_cells = std::min(std::max(scan.triangles / triangles_per_chunk, uint64_t(1)) * BAKE_CELLS_PER_CHUNK, uint64_t(BAKE_MAX_CELLS));
+        float    extent[3];
+        float    largest = 0.0f;
+
+        for (int i = 0; i < 3; i++)
+        {
+            origin[i] = scan.bounds_min[i];
+            extent[i] = scan.bounds_max[i] - scan.bounds_min[i];
+            largest   = std::max(largest, extent[i]);
+        }
+
+        // Flat axes would collapse the volume, which only decides the cell size here.
+        double volume = 1.0;
+
+        for (int i = 0; i < 3; i++)
+            volume *= std::max(extent[i], largest * 1e-3f + FLT_MIN);
+
+        float cell_size = float(cbrt(volume / double(target_cells)));
+
+        for (int i = 0; i < 3; i++)
+            cell_size = std::max(cell_size, extent[i] / float(BAKE_MAX_CELLS_PER_AXIS));
+
+        inv_cell_size = 1.0f / cell_size;
+
+        for (int i = 0; i < 3; i++)
+            dims[i] = std::min(std::max(uint32_t(ceilf(extent[i] * inv_cell_size)), 1u), uint32_t(BAKE_MAX_CELLS_PER_AXIS));
+    }
+
+    inline uint32_t cell_count() const { return dims[0] * dims[1] * dims[2]; }
+
+    uint32_t cell(const float* p) const
+    {
+        uint32_t c[3];
+
+        for (int i = 0; i < 3; i++)
+            c[i] = std::min(uint32_t(std::max((p[i] - origin[i]) * inv_cell_size, 0.0f)), dims[i] - 1);
+
+        return (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+    }
+
+    uint32_t morton(uint32_t cell) const
+    {
+        uint32_t x = cell % dims[0];
+        uint32_t y = (cell / dims[0]) % dims[1];
+        uint32_t z = cell / (dims[0] * dims[1]);
+
+        return spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Second pass: bins every triangle by its centroid and groups the occupied cells into chunks of exactly
+// triangles_per_chunk triangles (but the last one). A cell that does not fit is split across chunks, as the grid is
+// capped and outliers can leave most of the mesh in a handful of cells. The position cache and the scatter buffers
+// share the same cache_blocks budget, one after the other.
+static bool assign_chunks(const ScratchFiles& scratch, const BakeGrid& grid, uint32_t triangles_per_chunk, uint32_t cache_blocks, std::vector<uint32_t>& chunk_triangles)
+{
+    BlockReader positions;
+    FILE*       triangles = open_stream(scratch.triangles, "rb");
+    FILE*       cells     = open_stream(scratch.cells, "wb");
+
+    if (!positions.open(scratch.positions, cache_blocks) || !triangles || !cells)
+    {
+        if (triangles)
+            fclose(triangles);
+
+        if (cells)
+            fclose(cells);
+
+        return false;
+    }
+
+    std::vector<uint32_t> cell_triangles(grid.cell_count(), 0);
+    ObjTriangle           triangle;
+
+    while (fread(&triangle, sizeof(triangle), 1, triangles) == 1)
+    {
+        float centroid[3] = { 0.0f, 0.0f, 0.0f };
+
+        for (int i = 0; i < 3; i++)
+        {
+            const float* p = (const float*)positions.read(uint64_t(triangle.corners[i].v) * sizeof(float) * 3);
+
+            for (int j = 0; j < 3; j++)
+                centroid[j] += p[j] / 3.0f;
+        }
+
+        uint32_t cell = grid.cell(centroid);
+
+        cell_triangles[cell]++;
+        fwrite(&cell, sizeof(cell), 1, cells);
+    }
+
+    fclose(triangles);
+    positions.close();
+
+    if (fclose(cells) != 0)
+        return false;
+
+    std::vector<std::pair<uint32_t, uint32_t>> occupied;
+
+    for (uint32_t i = 0; i < grid.cell_count(); i++)
+    {
+        if (cell_triangles[i] > 0)
+            occupied.push_back({ grid.morton(i), i });
+    }
+
+    std::sort(occupied.begin(), occupied.end());
+
+    // Reuse the counts as the position of the next triangle of each cell in Morton order, which decides its chunk.
+    std::vector<uint32_t>& cell_cursors = cell_triangles;
+    uint32_t               total        = 0;
+
+    for (auto& cell : occupied)
+    {
+        uint32_t count = cell_cursors[cell.second];
+
+        cell_cursors[cell.second] = total;
+        total += count;
+    }
+
+    chunk_triangles.assign(size_t((uint64_t(total) + triangles_per_chunk - 1) / triangles_per_chunk), triangles_per_chunk);
+
+    if (total % triangles_per_chunk != 0)
+        chunk_triangles.back() = total % triangles_per_chunk;
+
+    // Third pass: scatter the triangles into one contiguous range per chunk, buffering a few per chunk between writes.
+    // The more chunks there are, the fewer each one buffers, so that the buffers fit in the cache budget.
+    uint64_t                 budget  = uint64_t(cache_blocks) * BAKE_BLOCK_SIZE / sizeof(ObjTriangle);
+    uint32_t                 scatter = uint32_t(std::min(std::max(budget / std::max(chunk_triangles.size(), size_t(1)), uint64_t(1)), uint64_t(BAKE_SCATTER_TRIANGLES)));
+    std::vector<uint64_t>    cursors(chunk_triangles.size());
+    std::vector<uint32_t>    pending(chunk_triangles.size(), 0);
+    std::vector<ObjTriangle> buffers(chunk_triangles.size() * scatter);
+    uint64_t                 offset  = 0;
+
+    for (size_t i = 0; i < chunk_triangles.size(); i++)
+    {
+        cursors[i] = offset;
+        offset += chunk_triangles[i];
+    }
+
+    FILE* sorted = fopen(scratch.sorted.c_str(), "wb");
+
+    triangles = open_stream(scratch.triangles, "rb");
+    cells     = open_stream(scratch.cells, "rb");
+
+    bool success = sorted && triangles && cells;
+
+    auto flush = [&](size_t chunk) {
+        seek_file(sorted, cursors[chunk] * sizeof(ObjTriangle));
+        fwrite(&buffers[chunk * scatter], sizeof(ObjTriangle), pending[chunk], sorted);
+
+        cursors[chunk] += pending[chunk];
+        pending[chunk] = 0;
+    };
+
+    uint32_t cell;
+
+    while (success && fread(&triangle, sizeof(triangle), 1, triangles) == 1 && fread(&cell, sizeof(cell), 1, cells) == 1)
+    {
+        uint32_t chunk = cell_cursors[cell]++ / triangles_per_chunk;
+
+        buffers[chunk * scatter + pending[chunk]++] = triangle;
+
+        if (pending[chunk] == scatter)
+            flush(chunk);
+    }
+
+    for (size_t i = 0; success && i < chunk_triangles.size(); i++)
+        flush(i);
+
+    if (triangles)
+        fclose(triangles);
+
+    if (cells)
+        fclose(cells);
+
+    if (sorted && fclose(sorted) != 0)
+        success = false;
+
+    return success;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Last pass: welds the corners of each chunk into chunk local vertices and writes the chunk file.
+static bool write_chunks(const std::string& chunk_path, const ScratchFiles& scratch, const ObjScan& scan, const std::vector<uint32_t>& chunk_triangles, uint32_t cache_blocks, MeshChunkBakeStats& stats)
+{
+    BlockReader positions;
+    BlockReader tex_coords;
+    BlockReader normals;
+
+    if (!positions.open(scratch.positions, cache_blocks) || !tex_coords.open(scratch.tex_coords, cache_blocks) || !normals.open(scratch.normals, cache_blocks))
+        return false;
+
+    FILE* sorted = open_stream(scratch.sorted, "rb");
+    FILE* out    = open_stream(chunk_path, "wb");
+
+    if (!sorted || !out)
+    {
+        if (sorted)
+            fclose(sorted);
+
+        if (out)
+            fclose(out);
+
+        return false;
+    }
+
+    MeshChunkHeader            header = {};
+    std::vector<MeshChunkDesc> descs(chunk_triangles.size());
+
+    header.magic       = MESH_CHUNK_MAGIC;
+    header.version     = MESH_CHUNK_VERSION;
+    header.chunk_count = uint32_t(descs.size());
+
+    for (int i = 0; i < 3; i++)
+    {
+        header.bounds_min[i] = scan.bounds_min[i];
+        header.bounds_max[i] = scan.bounds_max[i];
+    }
+
+    // The table is rewritten once the chunks are known.
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(descs.data(), sizeof(MeshChunkDesc), descs.size(), out);
+
+    std::vector<ObjTriangle>                               triangles;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> welded;
+    MeshChunkData                                          chunk;
+    std::vector<uint8_t>                                   needs_normal;
+
+    for (size_t i = 0; i < descs.size(); i++)
+    {
+        MeshChunkDesc& desc = descs[i];
+
+        triangles.resize(chunk_triangles[i]);
+
+        if (fread(triangles.data(), sizeof(ObjTriangle), triangles.size(), sorted) != triangles.size())
+            break;
+
+        welded.clear();
+        chunk.vertices.clear();
+        chunk.indices.clear();
+        needs_normal.clear();
+
+        for (const ObjTriangle& triangle : triangles)
+        {
+            for (const ObjCorner& corner : triangle.corners)
+            {
+                auto it = welded.find(corner);
+
+                if (it != welded.end())
+                {
+                    chunk.indices.push_back(it->second);
+                    continue;
+                }
+
+                ChunkVertex vertex = {};
+
+                memcpy(vertex.position, positions.read(uint64_t(corner.v) * sizeof(vertex.position)), sizeof(vertex.position));
+
+                if (corner.vt != INVALID_INDEX)
+                    memcpy(vertex.tex_coord, tex_coords.read(uint64_t(corner.vt) * sizeof(vertex.tex_coord)), sizeof(vertex.tex_coord));
+
+                if (corner.vn != INVALID_INDEX)
+                    memcpy(vertex.normal, normals.read(uint64_t(corner.vn) * sizeof(vertex.normal)), sizeof(vertex.normal));
+
+                welded[corner] = uint32_t(chunk.vertices.size());
+                chunk.indices.push_back(uint32_t(chunk.vertices.size()));
+                chunk.vertices.push_back(vertex);
+                needs_normal.push_back(corner.vn == INVALID_INDEX);
+            }
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            desc.bounds_min[j] = FLT_MAX;
+            desc.bounds_max[j] = -FLT_MAX;
+        }
+
+        for (const ChunkVertex& vertex : chunk.vertices)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                desc.bounds_min[j] = std::min(desc.bounds_min[j], vertex.position[j]);
+                desc.bounds_max[j] = std::max(desc.bounds_max[j], vertex.position[j]);
+            }
+        }
+
+        for (size_t j = 0; j < chunk.indices.size(); j += 3)
+        {
+            ChunkVertex& v0 = chunk.vertices[chunk.indices[j]];
+            ChunkVertex& v1 = chunk.vertices[chunk.indices[j + 1]];
+            ChunkVertex& v2 = chunk.vertices[chunk.indices[j + 2]];
+
+            float e0[3], e1[3], n[3];
+
+            for (int k = 0; k < 3; k++)
+            {
+                e0[k] = v1.position[k] - v0.position[k];
+                e1[k] = v2.position[k] - v0.position[k];
+            }
+
+            n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+            n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+            n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+
+            float uv_e0[2] = { v1.tex_coord[0] - v0.tex_coord[0], v1.tex_coord[1] - v0.tex_coord[1] };
+            float uv_e1[2] = { v2.tex_coord[0] - v0.tex_coord[0], v2.tex_coord[1] - v0.tex_coord[1] };
+
+            header.world_area += 0.5 * sqrt(double(n[0]) * n[0] + double(n[1]) * n[1] + double(n[2]) * n[2]);
+            header.uv_area += 0.5 * fabs(double(uv_e0[0]) * uv_e1[1] - double(uv_e0[1]) * uv_e1[0]);
+
+            // Corners without a normal get the area weighted average of the faces around them.
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t index = chunk.indices[j + k];
+
+                if (needs_normal[index])
+                {
+                    for (int l = 0; l < 3; l++)
+                        chunk.vertices[index].normal[l] += n[l];
+                }
+            }
+        }
+
+        for (size_t j = 0; j < chunk.vertices.size(); j++)
+        {
+            if (!needs_normal[j])
+                continue;
+
+            float* n      = chunk.vertices[j].normal;
+            float  length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            if (length > 0.0f)
+            {
+                for (int k = 0; k < 3; k++)
+                    n[k] /= length;
+            }
+            else
+                n[1] = 1.0f;
+        }
+
+        desc.offset       = tell_file(out);
+        desc.vertex_count = uint32_t(chunk.vertices.size());
+        desc.index_count  = uint32_t(chunk.indices.size());
+
+        fwrite(chunk.vertices.data(), sizeof(ChunkVertex), chunk.vertices.size(), out);
+        fwrite(chunk.indices.data(), sizeof(uint32_t), chunk.indices.size(), out);
+
+        header.vertex_count += desc.vertex_count;
+        header.triangle_count += desc.index_count / 3;
+
+        stats.largest_chunk = std::max(stats.largest_chunk, desc.index_count / 3);
+    }
+
+    fclose(sorted);
+
+    bool success = header.triangle_count == scan.triangles;
+
+    seek_file(out, 0);
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(descs.data(), sizeof(MeshChunkDesc), descs.size(), out);
+
+    if (fclose(out) != 0)
+        success = false;
+
+    stats.chunk_vertices = header.vertex_count;
+    stats.chunks         = header.chunk_count;
+
+    return success;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool bake_mesh_chunks(const std::string& obj_path, const std::string& chunk_path, uint32_t triangles_per_chunk, uint32_t cache_mb, MeshChunkBakeStats& stats)
+{
+    ScratchFiles scratch;
+
+    scratch.positions  = chunk_path + ".positions.tmp";
+    scratch.tex_coords = chunk_path + ".tex_coords.tmp";
+    scratch.normals    = chunk_path + ".normals.tmp";
+    scratch.triangles  = chunk_path + ".triangles.tmp";
+    scratch.cells      = chunk_path + ".cells.tmp";
+    scratch.sorted     = chunk_path + ".sorted.tmp";
+
+    stats = {};
+
+    ObjScan scan;
+
+    if (!split_obj(obj_path, scratch, scan))
+        return false;
+
+    stats.obj_vertices  = scan.positions;
+    stats.triangles     = scan.triangles;
+    stats.skipped_faces = scan.skipped;
+
+    // Three attribute streams are cached at the same time while writing the chunks.
+    uint32_t              cache_blocks = std::max(uint32_t(uint64_t(cache_mb) * 1024 * 1024 / (3 * BAKE_BLOCK_SIZE)), 1u);
+    std::vector<uint32_t> chunks;
+    BakeGrid              grid;
+
+    // Tiny chunks would make the per chunk bookkeeping grow with the mesh.
+    triangles_per_chunk = std::max(triangles_per_chunk, uint32_t(BAKE_MIN_CHUNK_TRIANGLES));
+
+    grid.init(scan, triangles_per_chunk);
+
+    if (!assign_chunks(scratch, grid, triangles_per_chunk, cache_blocks * 3, chunks))
+        return false;
+
+    return write_chunks(chunk_path, scratch, scan, chunks, cache_blocks, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MeshChunkFile::open(const std::string& path)
+{
+    close();
+
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (!file)
+        return false;
+
+    bool success = fread(&m_header, sizeof(m_header), 1, file) == 1 && m_header.magic == MESH_CHUNK_MAGIC && m_header.version == MESH_CHUNK_VERSION;
+
+    if (success)
+    {
+        m_chunks.resize(m_header.chunk_count);
+        success = fread(m_chunks.data(), sizeof(MeshChunkDesc), m_chunks.size(), file) == m_chunks.size();
+    }
+
+    fclose(file);
+
+    if (!success)
+    {
+        m_chunks.clear();
+        return false;
+    }
+
+    m_path = path;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MeshChunkFile::close()
+{
+    m_path.clear();
+    m_chunks.clear();
+    m_header = {};
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MeshChunkFile::read_chunk(uint32_t index, MeshChunkData& data) const
+{
+    const MeshChunkDesc& desc = m_chunks[index];
+    FILE*                file = fopen(m_path.c_str(), "rb");
+
+    if (!file)
+        return false;
+
+    data.vertices.resize(desc.vertex_count);
+    data.indices.resize(desc.index_count);
+
+    bool success = seek_file(file, desc.offset) && fread(data.vertices.data(), sizeof(ChunkVertex), data.vertices.size(), file) == data.vertices.size() && fread(data.indices.data(), sizeof(uint32_t), data.indices.size(), file) == data.indices.size();
+
+    fclose(file);
+
+    // A truncated or corrupt file must not turn into out of bounds reads on the GPU or in Embree.
+    for (size_t i = 0; success && i < data.indices.size(); i++)
+        success = data.indices[i] < desc.vertex_count;
+
+    return success;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t peak_rss_bytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return uint64_t(counters.PeakWorkingSetSize);
+
+    return 0;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#if defined(__APPLE__)
+    return uint64_t(usage.ru_maxrss);
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
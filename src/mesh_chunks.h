@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <string>
+
+#define MESH_CHUNK_MAGIC 0x4B4E4843 // 'CHNK'
+#define MESH_CHUNK_VERSION 1
+#define MESH_CHUNK_DEFAULT_TRIANGLES 65536
+#define MESH_CHUNK_DEFAULT_CACHE_MB 64
+
+// Vertex of a baked chunk. Tangents are not stored, none of the passes use them.
+struct ChunkVertex
+{
+    float position[3];
+    float tex_coord[2];
+    float normal[3];
+};
+
+struct MeshChunkHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunk_count;
+    uint32_t reserved;
+    uint64_t vertex_count;
+    uint64_t triangle_count;
+    float    bounds_min[3];
+    float    bounds_max[3];
+    // Surface area of the whole mesh in object space and in UV space, enough to pick the atlas size without loading it.
+    double world_area;
+    double uv_area;
+};
+
+// Entry of the chunk table that follows the header. The vertices of a chunk are stored at its offset, directly followed
+// by its indices, which are local to the chunk.
+struct MeshChunkDesc
+{
+    float    bounds_min[3];
+    float    bounds_max[3];
+    uint64_t offset;
+    uint32_t vertex_count;
+    uint32_t index_count;
+};
+
+struct MeshChunkData
+{
+    std::vector<ChunkVertex> vertices;
+    std::vector<uint32_t>    indices;
+};
+
+struct MeshChunkBakeStats
+{
+    uint64_t obj_vertices;
+    uint64_t triangles;
+    uint64_t skipped_faces; // Faces with a corner that is malformed or refers to a missing vertex.
+    uint64_t chunk_vertices;
+    uint32_t chunks;
+    uint32_t largest_chunk;
+};
+
+// Splits a Wavefront OBJ into spatially coherent chunks of roughly triangles_per_chunk triangles (at least 1024) and
+// writes them to a chunk file. The OBJ is streamed through scratch files next to the output, so memory use is bounded by
+// cache_mb plus a single chunk and the chunk table rather than by the size of the mesh.
+bool bake_mesh_chunks(const std::string& obj_path, const std::string& chunk_path, uint32_t triangles_per_chunk, uint32_t cache_mb, MeshChunkBakeStats& stats);
+
+// Read-only access to a chunk file. Only the header and the chunk table stay in memory, chunks are read on request.
+class MeshChunkFile
+{
+public:
+    bool open(const std::string& path);
+    void close();
+
+    // Safe to call from several threads at once, each call uses its own file handle.
+    bool read_chunk(uint32_t index, MeshChunkData& data) const;
+
+    inline bool                              is_open() const { return !m_path.empty(); }
+    inline const MeshChunkHeader&            header() const { return m_header; }
+    inline const std::vector<MeshChunkDesc>& chunks() const { return m_chunks; }
+
+private:
+    std::string                m_path;
+    MeshChunkHeader            m_header = {};
+    std::vector<MeshChunkDesc> m_chunks;
+};
+
+// Peak resident set size of the calling process in bytes, 0 if the platform does not report it.
+uint64_t peak_rss_bytes();
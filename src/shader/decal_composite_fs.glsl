@@ -0,0 +1,40 @@
+// ------------------------------------------------------------------
+// INPUT VARIABLES  -------------------------------------------------
+// ------------------------------------------------------------------
+
+in vec2 FS_IN_TexCoord;
+
+// ------------------------------------------------------------------
+// OUTPUT VARIABLES  ------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(location = 0) out vec4 FS_OUT_Albedo;
+layout(location = 1) out vec4 FS_OUT_Normal;
+layout(location = 2) out vec4 FS_OUT_Roughness;
+
+// ------------------------------------------------------------------
+// UNIFORMS  --------------------------------------------------------
+// ------------------------------------------------------------------
+
+uniform sampler2D s_Decal;
+uniform sampler2D s_DecalNormal;
+uniform sampler2D s_DecalRoughness;
+uniform vec4      u_Rect;
+uniform float     u_Level;
+
+// ------------------------------------------------------------------
+// MAIN  ------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main(void)
+{
+    // The viewport covers only the affected rectangle, so remap the fullscreen triangle coordinates into atlas UVs.
+    vec2 uv = mix(u_Rect.xy, u_Rect.zw, FS_IN_TexCoord);
+
+    // Sample the level the decal was rendered into, it is magnified when compositing into finer levels.
+    FS_OUT_Albedo    = textureLod(s_Decal, uv, u_Level);
+    FS_OUT_Normal    = textureLod(s_DecalNormal, uv, u_Level);
+    FS_OUT_Roughness = textureLod(s_DecalRoughness, uv, u_Level);
+}
+
+// ------------------------------------------------------------------
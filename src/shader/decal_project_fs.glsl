@@ -3,12 +3,15 @@
 // ------------------------------------------------------------------
 
 in vec3 FS_IN_WorldPos;
+in vec3 FS_IN_Normal;
 
 // ------------------------------------------------------------------
 // OUTPUT VARIABLES  ------------------------------------------------
 // ------------------------------------------------------------------
 
-out vec4 FS_OUT_Color;
+layout(location = 0) out vec4 FS_OUT_Albedo;
+layout(location = 1) out vec4 FS_OUT_Normal;
+layout(location = 2) out vec4 FS_OUT_Roughness;
 
 // ------------------------------------------------------------------
 // UNIFORMS  --------------------------------------------------------
@@ -22,7 +25,10 @@ layout(std140) uniform GlobalUniforms
 };
 
 uniform sampler2D s_Decal;
+uniform sampler2D s_DecalNormal;
+uniform sampler2D s_DecalRoughness;
 uniform sampler2D s_Depth;
+uniform mat4      u_DecalToObject;
 
 #define BIAS 0.001
 
@@ -35,6 +41,38 @@ bool is_outside_decal_bounds(vec3 uv)
     return (uv.x > 1.0 || uv.x < 0.0 || uv.y > 1.0 || uv.y < 0.0 || uv.z > 1.0 || uv.z < 0.0);
 }
 
+// ------------------------------------------------------------------
+
+// Orthonormal basis around a unit vector (Duff et al. 2017). Must match mesh_fs.glsl, which rebuilds the same frame.
+void surface_basis(vec3 n, out vec3 t, out vec3 b)
+{
+    float s = n.z >= 0.0 ? 1.0 : -1.0;
+    float a = -1.0 / (s + n.z);
+    float c = n.x * n.y * a;
+
+    t = vec3(1.0 + s * n.x * n.x * a, s * c, -s * n.x);
+    b = vec3(c, s + n.y * n.y * a, -n.y);
+}
+
+// ------------------------------------------------------------------
+
+// Rotates the detail normal by the rotation that takes +Z to the base normal (reoriented normal mapping).
+vec3 reoriented_normal_blend(vec3 base, vec3 detail)
+{
+    vec3 t = base + vec3(0.0, 0.0, 1.0);
+    vec3 u = detail * vec3(-1.0, -1.0, 1.0);
+
+    return normalize(t * dot(t, u) / max(t.z, 1e-4) - u);
+}
+
+// ------------------------------------------------------------------
+
+// The atlas stores the normal relative to the surface, with the flat normal exact in 8 bits. Must match mesh_fs.glsl.
+vec3 encode_normal_delta(vec3 n)
+{
+    return (n * 127.0 + 128.0) / 255.0;
+}
+
 // ------------------------------------------------------------------
 // MAIN  ------------------------------------------------------------
 // ------------------------------------------------------------------
@@ -59,8 +97,28 @@ void main(void)
     if ((decal_uv.z - BIAS) > compare_depth)
         discard;
 
-    // Sample the decal texture using the Decal UVs.
-    FS_OUT_Color = texture(s_Decal, decal_uv.xy);
+    // Sample the decal layers using the Decal UVs.
+    vec4 albedo = texture(s_Decal, decal_uv.xy);
+
+    // The projector looks down -Z so the tangent space of the decal matches the projector's view space. Reorient the
+    // decal normal onto the surface normal in that space, so that it follows the curvature under the decal.
+    mat3 decal_to_object = mat3(u_DecalToObject);
+    vec3 surface_normal  = normalize(FS_IN_Normal);
+    vec3 base            = normalize(surface_normal * decal_to_object);
+    vec3 detail          = texture(s_DecalNormal, decal_uv.xy).xyz * 2.0 - 1.0;
+    vec3 object_normal   = normalize(decal_to_object * reoriented_normal_blend(base, detail));
+
+    // Store it relative to the surface frame, which the mesh shader rebuilds from the same vertex normal.
+    vec3 t;
+    vec3 b;
+    surface_basis(surface_normal, t, b);
+
+    vec3 normal = vec3(dot(object_normal, t), dot(object_normal, b), dot(object_normal, surface_normal));
+
+    // Every channel is blended with the alpha of the albedo layer so that they share the same shape.
+    FS_OUT_Albedo    = albedo;
+    FS_OUT_Normal    = vec4(encode_normal_delta(normal), albedo.a);
+    FS_OUT_Roughness = vec4(texture(s_DecalRoughness, decal_uv.xy).r, 0.0, 0.0, albedo.a);
 }
 
 // ------------------------------------------------------------------
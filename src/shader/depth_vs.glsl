@@ -3,10 +3,6 @@
 // ------------------------------------------------------------------
 
 layout(location = 0) in vec3 VS_IN_Position;
-layout(location = 1) in vec2 VS_IN_Texcoord;
-layout(location = 2) in vec3 VS_IN_Normal;
-layout(location = 3) in vec3 VS_IN_Tangent;
-layout(location = 4) in vec3 VS_IN_Bitangent;
 
 // ------------------------------------------------------------------
 // UNIFORMS ---------------------------------------------------------
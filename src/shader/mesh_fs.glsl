@@ -16,7 +16,39 @@ in vec2 FS_IN_TexCoord;
 // UNIFORMS ---------------------------------------------------------
 // ------------------------------------------------------------------
 
-uniform sampler2D s_Texture;
+layout(std140) uniform GlobalUniforms
+{
+    mat4 view_proj;
+    mat4 decal_view_proj;
+    vec4 cam_pos;
+};
+
+uniform sampler2D s_Albedo;
+uniform sampler2D s_Normal;
+uniform sampler2D s_Roughness;
+uniform mat4      u_Model;
+
+// ------------------------------------------------------------------
+// FUNCTIONS  -------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Orthonormal basis around a unit vector (Duff et al. 2017). Must match decal_project_fs.glsl.
+void surface_basis(vec3 n, out vec3 t, out vec3 b)
+{
+    float s = n.z >= 0.0 ? 1.0 : -1.0;
+    float a = -1.0 / (s + n.z);
+    float c = n.x * n.y * a;
+
+    t = vec3(1.0 + s * n.x * n.x * a, s * c, -s * n.x);
+    b = vec3(c, s + n.y * n.y * a, -n.y);
+}
+
+// ------------------------------------------------------------------
+
+vec3 decode_normal_delta(vec3 c)
+{
+    return (c * 255.0 - 128.0) / 127.0;
+}
 
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
@@ -24,13 +56,25 @@ uniform sampler2D s_Texture;
 
 void main()
 {
+    // The interpolated vertex normal keeps the shading smooth, the 8 bit atlas only holds the decals' deviation from it.
+    vec3 surface_normal = normalize(FS_IN_Normal);
+    vec3 t;
+    vec3 b;
+    surface_basis(surface_normal, t, b);
+
+    vec3  delta     = decode_normal_delta(texture(s_Normal, FS_IN_TexCoord).xyz);
     vec3  light_pos = vec3(200.0, 200.0, 200.0);
-    vec3  n         = normalize(FS_IN_Normal);
+    vec3  n         = normalize(mat3(u_Model) * (t * delta.x + b * delta.y + surface_normal * delta.z));
     vec3  l         = normalize(light_pos - FS_IN_WorldPos);
+    vec3  v         = normalize(cam_pos.xyz - FS_IN_WorldPos);
+    vec3  h         = normalize(l + v);
     float lambert   = max(0.0f, dot(n, l));
-    vec3  diffuse   = texture(s_Texture, FS_IN_TexCoord).xyz;
+    float roughness = texture(s_Roughness, FS_IN_TexCoord).r;
+    float shininess = mix(256.0, 4.0, roughness);
+    float specular  = pow(max(0.0, dot(n, h)), shininess) * (1.0 - roughness) * lambert;
+    vec3  diffuse   = texture(s_Albedo, FS_IN_TexCoord).xyz;
     vec3  ambient   = diffuse * 0.03;
-    vec3  color     = diffuse * lambert + ambient;
+    vec3  color     = diffuse * lambert + ambient + vec3(specular);
     FS_OUT_Color    = color;
 }
 
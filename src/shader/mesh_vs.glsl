@@ -37,7 +37,7 @@ void main()
 {
     vec4 world_pos = u_Model * vec4(VS_IN_Position, 1.0f);
     FS_IN_WorldPos = world_pos.xyz;
-    FS_IN_Normal   = normalize(normalize(mat3(u_Model) * VS_IN_Normal));
+    FS_IN_Normal   = VS_IN_Normal;
     FS_IN_TexCoord = VS_IN_Texcoord;
 
     gl_Position = view_proj * world_pos;
@@ -8,7 +8,9 @@ in vec3 FS_IN_WorldPos;
 // OUTPUT VARIABLES  ------------------------------------------------
 // ------------------------------------------------------------------
 
-out vec4 FS_OUT_Color;
+layout(location = 0) out vec4 FS_OUT_Albedo;
+layout(location = 1) out vec4 FS_OUT_Normal;
+layout(location = 2) out vec4 FS_OUT_Roughness;
 
 // ------------------------------------------------------------------
 // UNIFORMS  --------------------------------------------------------
@@ -21,13 +23,18 @@ layout(std140) uniform GlobalUniforms
     vec4 cam_pos;
 };
 
+#define BASE_ROUGHNESS 0.8
+
 // ------------------------------------------------------------------
 // MAIN  ------------------------------------------------------------
 // ------------------------------------------------------------------
 
 void main(void)
 {
-    FS_OUT_Color = vec4(1.0);
+    FS_OUT_Albedo    = vec4(1.0);
+    // The flat normal relative to the surface, see encode_normal_delta() in decal_project_fs.glsl.
+    FS_OUT_Normal    = vec4(128.0 / 255.0, 128.0 / 255.0, 1.0, 1.0);
+    FS_OUT_Roughness = vec4(BASE_ROUGHNESS, 0.0, 0.0, 1.0);
 }
 
 // ------------------------------------------------------------------
@@ -0,0 +1,363 @@
+#include "task_scheduler.h"
+#include <chrono>
+#include <algorithm>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Slot of the calling thread. Threads the scheduler does not know about share slot 0 with the thread that started it.
+static thread_local uint32_t g_thread_index = 0;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t now_ns()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void pin_thread(std::thread::native_handle_type handle, uint32_t core)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+
+    pthread_setaffinity_np(handle, sizeof(cpu_set_t), &set);
+#else
+    (void)handle;
+    (void)core;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TaskScheduler::~TaskScheduler()
+{
+    stop();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TaskScheduler::start(uint32_t thread_count, bool pin_threads)
+{
+    if (m_running)
+        return false;
+
+    uint32_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    if (thread_count == 0)
+        thread_count = hardware_threads;
+
+    m_queues.resize(thread_count);
+
+    for (auto& queue : m_queues)
+    {
+        queue = std::make_unique<ThreadQueue>();
+        queue->tasks.reserve(TASK_QUEUE_CAPACITY);
+    }
+
+    m_stats.resize(thread_count);
+    m_sample_time_ns = now_ns();
+    m_running        = true;
+
+    g_thread_index = 0;
+
+#if defined(__linux__)
+    if (pin_threads)
+        pin_thread(pthread_self(), 0);
+#endif
+
+    for (uint32_t i = 1; i < thread_count; i++)
+    {
+        m_workers.emplace_back(&TaskScheduler::worker_thread, this, i);
+
+        if (pin_threads)
+            pin_thread(m_workers.back().native_handle(), i % hardware_threads);
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::stop()
+{
+    if (!m_running)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_running = false;
+    }
+
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+
+    m_workers.clear();
+    m_queues.clear();
+    m_stats.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::run(TaskGroup& group, std::function<void()> task)
+{
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+
+    // Without workers the task simply runs on the calling thread.
+    if (!m_running)
+    {
+        task();
+        group.pending.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    Task queued;
+
+    queued.fn    = std::move(task);
+    queued.group = &group;
+
+    push(std::move(queued));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::push(Task&& task)
+{
+    ThreadQueue& queue = *m_queues[g_thread_index];
+
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+        m_queued.fetch_add(1, std::memory_order_release);
+    }
+
+    // Taking the lock orders this against a worker that is about to sleep, so the wake up cannot be lost.
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+    }
+
+    m_wake.notify_one();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::wait(TaskGroup& group)
+{
+    Task task;
+
+    // Help out instead of blocking, the tasks of the group are most likely still in this thread's own queue.
+    while (group.pending.load(std::memory_order_acquire) > 0)
+    {
+        if (m_running && pop_task(g_thread_index, task))
+            execute(g_thread_index, task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::parallel_for_range(uint32_t count, uint32_t grain, const void* context, RangeFn range)
+{
+    grain = std::max(grain, 1u);
+
+    // Not worth a task if it would be the only one.
+    if (count <= grain || !m_running)
+    {
+        if (count > 0)
+            range(context, 0, count);
+
+        return;
+    }
+
+    TaskGroup group;
+
+    for (uint32_t begin = grain; begin < count; begin += grain)
+    {
+        Task task;
+
+        task.range   = range;
+        task.context = context;
+        task.begin   = begin;
+        task.end     = std::min(begin + grain, count);
+        task.group   = &group;
+
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        push(std::move(task));
+    }
+
+    // The calling thread takes the first chunk itself.
+    range(context, 0, grain);
+
+    wait(group);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::stats(std::vector<TaskWorkerStats>& stats)
+{
+    uint64_t now     = now_ns();
+    uint64_t elapsed = now - m_sample_time_ns;
+
+    if (elapsed >= TASK_STATS_WINDOW_NS)
+    {
+        for (uint32_t i = 0; i < m_queues.size(); i++)
+        {
+            ThreadQueue& queue   = *m_queues[i];
+            uint64_t     busy_ns = queue.busy_ns.load(std::memory_order_relaxed);
+
+            m_stats[i].utilization = std::min(float(double(busy_ns - queue.sampled_busy_ns) / double(elapsed)), 1.0f);
+            queue.sampled_busy_ns  = busy_ns;
+        }
+
+        m_sample_time_ns = now;
+    }
+
+    for (uint32_t i = 0; i < m_queues.size(); i++)
+    {
+        m_stats[i].tasks  = m_queues[i]->tasks_run.load(std::memory_order_relaxed);
+        m_stats[i].steals = m_queues[i]->steals.load(std::memory_order_relaxed);
+    }
+
+    stats = m_stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::worker_thread(uint32_t index)
+{
+    Task task;
+
+    g_thread_index = index;
+
+    while (true)
+    {
+        if (pop_task(index, task))
+        {
+            execute(index, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+
+        m_wake.wait(lock, [this]() { return !m_running || m_queued.load(std::memory_order_acquire) > 0; });
+
+        if (!m_running)
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TaskScheduler::pop_task(uint32_t index, Task& task)
+{
+    if (m_queued.load(std::memory_order_acquire) == 0)
+        return false;
+
+    // Newest task of our own queue first, as it is the most likely to still be in cache.
+    {
+        ThreadQueue&                queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (!queue.tasks.empty())
+        {
+            queue.tasks.pop_back(task);
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Otherwise steal the oldest task of another thread, which tends to be the largest remaining piece of work.
+    uint32_t count = uint32_t(m_queues.size());
+
+    for (uint32_t i = 1; i < count; i++)
+    {
+        ThreadQueue&                victim = *m_queues[(index + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty())
+        {
+            victim.tasks.pop_front(task);
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            m_queues[index]->steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::execute(uint32_t index, Task& task)
+{
+    ThreadQueue& queue = *m_queues[index];
+    uint64_t     start = now_ns();
+
+    if (task.range)
+        task.range(task.context, task.begin, task.end);
+    else
+    {
+        task.fn();
+        task.fn = nullptr;
+    }
+
+    queue.busy_ns.fetch_add(now_ns() - start, std::memory_order_relaxed);
+    queue.tasks_run.fetch_add(1, std::memory_order_relaxed);
+
+    task.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::TaskRing::reserve(uint32_t capacity)
+{
+    if (capacity <= m_slots.size())
+        return;
+
+    std::vector<Task> slots(capacity);
+
+    for (uint32_t i = 0; i < m_count; i++)
+        slots[i] = std::move(m_slots[(m_head + i) % m_slots.size()]);
+
+    m_slots.swap(slots);
+    m_head = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::TaskRing::push_back(Task&& task)
+{
+    if (m_count == m_slots.size())
+        reserve(std::max(uint32_t(m_slots.size()) * 2, 1u));
+
+    m_slots[(m_head + m_count) % m_slots.size()] = std::move(task);
+    m_count++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::TaskRing::pop_back(Task& task)
+{
+    m_count--;
+    task = std::move(m_slots[(m_head + m_count) % m_slots.size()]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TaskScheduler::TaskRing::pop_front(Task& task)
+{
+    task = std::move(m_slots[m_head]);
+
+    m_head = (m_head + 1) % m_slots.size();
+    m_count--;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
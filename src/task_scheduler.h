@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#define TASK_STATS_WINDOW_NS 500000000ull
+#define TASK_QUEUE_CAPACITY 256
+
+// Counts the outstanding tasks of a batch so that the submitting thread can wait for (and help with) all of them.
+struct TaskGroup
+{
+    std::atomic<uint32_t> pending { 0 };
+};
+
+struct TaskWorkerStats
+{
+    uint64_t tasks;
+    uint64_t steals;
+    // Fraction of the last sampling window spent running tasks.
+    float utilization;
+};
+
+// Work-stealing task scheduler. Every thread owns a queue: it pushes and pops at the back, while idle threads steal from
+// the front of the others. The thread that calls start() is slot 0 and runs tasks while it waits on a group, so a
+// scheduler with N threads creates N - 1 workers.
+class TaskScheduler
+{
+public:
+    ~TaskScheduler();
+
+    // A thread count of 0 uses every hardware thread. Pinning binds thread i to core i.
+    bool start(uint32_t thread_count, bool pin_threads);
+    void stop();
+
+    void run(TaskGroup& group, std::function<void()> task);
+    void wait(TaskGroup& group);
+
+    // Splits [0, count) into chunks of at most grain items, runs fn(begin, end) on each and returns once all are done.
+    // The chunks call fn through a plain function pointer, so unlike run() this never allocates.
+    template <typename Fn>
+    void parallel_for(uint32_t count, uint32_t grain, const Fn& fn)
+    {
+        parallel_for_range(count, grain, &fn, [](const void* context, uint32_t begin, uint32_t end) { (*static_cast<const Fn*>(context))(begin, end); });
+    }
+
+    // Per-thread counters. Utilization is resampled at most every TASK_STATS_WINDOW_NS.
+    void stats(std::vector<TaskWorkerStats>& stats);
+
+    inline uint32_t thread_count() const { return uint32_t(m_queues.size()); }
+    inline bool     is_running() const { return m_running; }
+
+private:
+    typedef void (*RangeFn)(const void* context, uint32_t begin, uint32_t end);
+
+    // Either a function, or a chunk of a parallel_for when range is set.
+    struct Task
+    {
+        std::function<void()> fn;
+        RangeFn               range   = nullptr;
+        const void*           context = nullptr;
+        uint32_t              begin   = 0;
+        uint32_t              end     = 0;
+        TaskGroup*            group   = nullptr;
+    };
+
+    // Ring buffer of tasks. Unlike a deque it keeps its storage when emptied, so that it stops allocating once it has
+    // grown to the deepest the queue gets.
+    class TaskRing
+    {
+    public:
+        void reserve(uint32_t capacity);
+        void push_back(Task&& task);
+        void pop_back(Task& task);
+        void pop_front(Task& task);
+
+        inline bool empty() const { return m_count == 0; }
+
+    private:
+        std::vector<Task> m_slots;
+        uint32_t          m_head  = 0;
+        uint32_t          m_count = 0;
+    };
+
+    struct alignas(64) ThreadQueue
+    {
+        std::mutex            mutex;
+        TaskRing              tasks;
+        std::atomic<uint64_t> busy_ns { 0 };
+        std::atomic<uint64_t> tasks_run { 0 };
+        std::atomic<uint64_t> steals { 0 };
+        uint64_t              sampled_busy_ns = 0;
+    };
+
+    void parallel_for_range(uint32_t count, uint32_t grain, const void* context, RangeFn range);
+    void push(Task&& task);
+    void worker_thread(uint32_t index);
+    bool pop_task(uint32_t index, Task& task);
+    void execute(uint32_t index, Task& task);
+
+private:
+    std::vector<std::unique_ptr<ThreadQueue>> m_queues;
+    std::vector<std::thread>                  m_workers;
+    std::mutex                                m_sleep_mutex;
+    std::condition_variable                   m_wake;
+    std::atomic<uint32_t>                     m_queued { 0 };
+    std::atomic<bool>                         m_running { false };
+    std::vector<TaskWorkerStats>              m_stats;
+    uint64_t                                  m_sample_time_ns = 0;
+};
@@ -0,0 +1,190 @@
+#include "undo_history.h"
+#include <string.h>
+#include <algorithm>
+
+#define RLE_MAX_LITERAL 128
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN 130
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t tile_encode_bound(size_t size)
+{
+    // Worst case is all literals, one control byte per 128 bytes.
+    return size + (size + RLE_MAX_LITERAL - 1) / RLE_MAX_LITERAL;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint8_t delta_at(const uint8_t* src, size_t i, uint32_t pixel_size)
+{
+    return i < pixel_size ? src[i] : uint8_t(src[i] - src[i - pixel_size]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t tile_encode(const uint8_t* src, size_t size, uint32_t pixel_size, uint8_t* dst)
+{
+    size_t out     = 0;
+    size_t i       = 0;
+    size_t literal = SIZE_MAX;
+
+    // Control byte: [0, 127] is followed by (n + 1) literal bytes, [128, 255] repeats the next byte (n - 125) times.
+    while (i < size)
+    {
+        uint8_t value = delta_at(src, i, pixel_size);
+        size_t  run   = 1;
+
+        while (i + run < size && run < RLE_MAX_RUN && delta_at(src, i + run, pixel_size) == value)
+            run++;
+
+        if (run >= RLE_MIN_RUN)
+        {
+            literal    = SIZE_MAX;
+            dst[out++] = uint8_t(run + 125);
+            dst[out++] = value;
+            i += run;
+        }
+        else
+        {
+            // Extend the open literal packet, or start a new one.
+            if (literal == SIZE_MAX)
+            {
+                literal    = out;
+                dst[out++] = 0;
+            }
+            else
+                dst[literal]++;
+
+            dst[out++] = value;
+            i++;
+
+            if (dst[literal] == RLE_MAX_LITERAL - 1)
+                literal = SIZE_MAX;
+        }
+    }
+
+    return out;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t tile_decode(const uint8_t* src, size_t src_size, uint32_t pixel_size, uint8_t* dst, size_t dst_size)
+{
+    size_t in  = 0;
+    size_t out = 0;
+
+    while (in < src_size && out < dst_size)
+    {
+        uint8_t control = src[in++];
+
+        if (control < RLE_MAX_LITERAL)
+        {
+            size_t count = std::min(size_t(control) + 1, dst_size - out);
+
+            memcpy(dst + out, src + in, count);
+            in += count;
+            out += count;
+        }
+        else
+        {
+            size_t count = std::min(size_t(control) - 125, dst_size - out);
+
+            memset(dst + out, src[in++], count);
+            out += count;
+        }
+    }
+
+    // Undo the delta coding.
+    for (size_t i = pixel_size; i < out; i++)
+        dst[i] = uint8_t(dst[i] + dst[i - pixel_size]);
+
+    return in;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+HistoryStack::HistoryStack(size_t capacity) :
+    m_arena(capacity)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void HistoryStack::clear()
+{
+    m_steps.clear();
+    m_head = 0;
+    m_used = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool HistoryStack::push(const uint8_t* data, size_t size, size_t raw_size, std::vector<HistoryTile>& tiles)
+{
+    const size_t capacity = m_arena.size();
+
+    if (size > capacity)
+        return false;
+
+    while (m_used + size > capacity)
+        evict_oldest();
+
+    HistoryStep step;
+
+    step.begin    = m_head;
+    step.size     = size;
+    step.raw_size = raw_size;
+    step.tiles.swap(tiles);
+
+    // Copy in up to two segments when the blob wraps around the end of the arena.
+    size_t first = std::min(size, capacity - m_head);
+
+    memcpy(&m_arena[m_head], data, first);
+    memcpy(&m_arena[0], data + first, size - first);
+
+    m_head = (m_head + size) % capacity;
+    m_used += size;
+
+    m_steps.push_back(std::move(step));
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool HistoryStack::pop(std::vector<uint8_t>& data, HistoryStep& step)
+{
+    if (m_steps.empty())
+        return false;
+
+    const size_t capacity = m_arena.size();
+
+    step = std::move(m_steps.back());
+    m_steps.pop_back();
+
+    data.resize(step.size);
+
+    size_t first = std::min(step.size, capacity - step.begin);
+
+    memcpy(data.data(), &m_arena[step.begin], first);
+    memcpy(data.data() + first, &m_arena[0], step.size - first);
+
+    // The newest step always ends at the head, so popping it just rewinds the head.
+    m_head = step.begin;
+    m_used -= step.size;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void HistoryStack::evict_oldest()
+{
+    // The oldest step always starts at the tail, so dropping it only shrinks the used range.
+    m_used -= m_steps.front().size;
+    m_steps.pop_front();
+    m_evicted++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <deque>
+
+// Delta + run-length codec for texture tiles. Each component is delta coded against the same component of the previous
+// pixel, which turns flat or smoothly varying regions into runs of zeros that the RLE stage collapses.
+size_t tile_encode_bound(size_t size);
+size_t tile_encode(const uint8_t* src, size_t size, uint32_t pixel_size, uint8_t* dst);
+size_t tile_decode(const uint8_t* src, size_t src_size, uint32_t pixel_size, uint8_t* dst, size_t dst_size);
+
+struct HistoryTile
+{
+    uint16_t x;
+    uint16_t y;
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct HistoryStep
+{
+    size_t                   begin;
+    size_t                   size;
+    size_t                   raw_size;
+    std::vector<HistoryTile> tiles;
+};
+
+// Stack of compressed steps stored in a fixed size ring arena. Pushing a step that does not fit evicts the oldest steps,
+// so memory stays bounded no matter how many steps are recorded.
+class HistoryStack
+{
+public:
+    explicit HistoryStack(size_t capacity);
+
+    void clear();
+
+    // Copies the blob into the arena. Fails only if the blob is larger than the whole arena.
+    bool push(const uint8_t* data, size_t size, size_t raw_size, std::vector<HistoryTile>& tiles);
+
+    // Pops the newest step, copying its blob out of the arena.
+    bool pop(std::vector<uint8_t>& data, HistoryStep& step);
+
+    inline bool   empty() const { return m_steps.empty(); }
+    inline size_t step_count() const { return m_steps.size(); }
+    inline size_t used() const { return m_used; }
+    inline size_t capacity() const { return m_arena.size(); }
+    inline size_t evicted() const { return m_evicted; }
+
+private:
+    void evict_oldest();
+
+private:
+    std::vector<uint8_t>    m_arena;
+    std::deque<HistoryStep> m_steps;
+    size_t                  m_head    = 0;
+    size_t                  m_used    = 0;
+    size_t                  m_evicted = 0;
+};
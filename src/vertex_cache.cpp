@@ -0,0 +1,188 @@
+#include "vertex_cache.h"
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#define VERTEX_CACHE_SIZE 32
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRI_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float vertex_score(int32_t cache_position, uint32_t remaining_triangles)
+{
+    // Vertices that are not used by any remaining triangle should never be picked.
+    if (remaining_triangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+
+    if (cache_position >= 0)
+    {
+        // The three vertices of the last triangle get a fixed score so that the next triangle doesn't simply reuse them
+        // in the same order.
+        if (cache_position < 3)
+            score = LAST_TRI_SCORE;
+        else
+        {
+            const float scaler = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score              = powf(1.0f - (cache_position - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    // Boost vertices with few remaining triangles so that lone triangles are cleared up early.
+    score += VALENCE_BOOST_SCALE * powf(float(remaining_triangles), -VALENCE_BOOST_POWER);
+
+    return score;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count)
+{
+    const uint32_t triangle_count = index_count / 3;
+
+    if (triangle_count == 0)
+        return;
+
+    // Build the vertex -> triangle adjacency.
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+
+    for (uint32_t i = 0; i < index_count; i++)
+        remaining[indices[i]]++;
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+        offsets[i + 1] = offsets[i] + remaining[i];
+
+    std::vector<uint32_t> adjacency(index_count);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+    for (uint32_t i = 0; i < index_count; i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<float> scores(vertex_count);
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+        scores[i] = vertex_score(-1, remaining[i]);
+
+    std::vector<bool> emitted(triangle_count, false);
+
+    std::vector<uint32_t> output(index_count);
+    uint32_t              cache[VERTEX_CACHE_SIZE + 3];
+    uint32_t              cache_count = 0;
+    int64_t               best        = -1;
+    uint32_t              scan_cursor = 0;
+
+    for (uint32_t t = 0; t < triangle_count; t++)
+    {
+        // If the cache did not yield a candidate fall back to the next un-emitted triangle in input order.
+        if (best < 0)
+        {
+            while (emitted[scan_cursor])
+                scan_cursor++;
+
+            best = scan_cursor;
+        }
+
+        const uint32_t* tri = &indices[best * 3];
+
+        output[t * 3]     = tri[0];
+        output[t * 3 + 1] = tri[1];
+        output[t * 3 + 2] = tri[2];
+        emitted[best]     = true;
+
+        // Remove the triangle from the adjacency of its vertices.
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t  v     = tri[k];
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end   = begin + remaining[v];
+            uint32_t* it    = std::find(begin, end, uint32_t(best));
+
+            *it = *(end - 1);
+            remaining[v]--;
+        }
+
+        // Push the triangle's vertices to the front of the cache.
+        uint32_t new_cache[VERTEX_CACHE_SIZE + 3];
+        uint32_t new_count = 0;
+
+        for (uint32_t k = 0; k < 3; k++)
+            new_cache[new_count++] = tri[k];
+
+        for (uint32_t k = 0; k < cache_count; k++)
+        {
+            uint32_t v = cache[k];
+
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                new_cache[new_count++] = v;
+        }
+
+        // Re-score every vertex touched by this step, including the ones that just fell out of the cache.
+        for (uint32_t k = 0; k < new_count; k++)
+        {
+            uint32_t v        = new_cache[k];
+            int32_t  position = k < VERTEX_CACHE_SIZE ? int32_t(k) : -1;
+
+            scores[v] = vertex_score(position, remaining[v]);
+        }
+
+        cache_count = std::min(new_count, uint32_t(VERTEX_CACHE_SIZE));
+        memcpy(cache, new_cache, sizeof(uint32_t) * cache_count);
+
+        // Pick the best scoring triangle among those that touch the cache.
+        float best_score = -1.0f;
+        best             = -1;
+
+        for (uint32_t k = 0; k < new_count; k++)
+        {
+            uint32_t v = new_cache[k];
+
+            for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+            {
+                uint32_t        candidate = adjacency[a];
+                const uint32_t* c         = &indices[candidate * 3];
+                float           score     = scores[c[0]] + scores[c[1]] + scores[c[2]];
+
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best       = candidate;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), sizeof(uint32_t) * index_count);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float average_cache_miss_ratio(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size)
+{
+    if (index_count < 3)
+        return 0.0f;
+
+    // Simulate a FIFO cache by remembering the miss counter at which each vertex was last inserted.
+    std::vector<int64_t> inserted_at(vertex_count, -int64_t(cache_size) - 1);
+    int64_t              misses = 0;
+
+    for (uint32_t i = 0; i < index_count; i++)
+    {
+        uint32_t v = indices[i];
+
+        if (misses - inserted_at[v] > int64_t(cache_size))
+        {
+            inserted_at[v] = misses;
+            misses++;
+        }
+    }
+
+    return float(misses) / float(index_count / 3);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
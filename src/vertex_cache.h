@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+// Reorders the triangles of an indexed triangle list for post-transform vertex cache locality (Tom Forsyth's linear-speed
+// algorithm). Vertex order is left untouched so the result can be drawn with the same base vertex as the input.
+void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count);
+
+// Average cache miss ratio (transformed vertices per triangle) of an index list for a FIFO cache of the given size.
+float average_cache_miss_ratio(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = 32);